@@ -0,0 +1,250 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+#define RCU_FREE(ptr)                   kfree_rcu(ptr, rcu)
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+
+/*
+ * The low bit of p_next marks its node as logically deleted.  A marked p_next
+ * never changes again, so a single CAS on the predecessor both validates and
+ * commits an update.
+ */
+#define is_marked(p_node)	((unsigned long)(p_node) & 1UL)
+#define get_marked(p_node)	((node_t *)((unsigned long)(p_node) | 1UL))
+#define get_unmarked(p_node)	((node_t *)((unsigned long)(p_node) & ~1UL))
+
+/*
+ * Find the first node not less than a value, and its predecessor
+ *
+ * Unlinks the marked nodes on the way.  The updater whose CAS unlinks a node
+ * frees it after a grace period, which is what keeps the traversals of other
+ * readers safe.  Caller should be in a read-side critical section.
+ */
+static void harris_search(list_t *p_list, val_t val,
+		node_t **pp_prev, node_t **pp_curr)
+{
+	node_t *p_prev, *p_curr, *p_next;
+
+retry:
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_curr = get_unmarked(RCU_DEREF(p_prev->p_next));
+
+	while (1) {
+		p_next = (node_t *)RCU_DEREF(READ_ONCE(p_curr->p_next));
+
+		while (is_marked(p_next)) {
+			if (cmpxchg(&p_prev->p_next, p_curr,
+						get_unmarked(p_next)) != p_curr)
+				goto retry;
+			RCU_FREE(p_curr);
+
+			p_curr = get_unmarked(p_next);
+			p_next = (node_t *)RCU_DEREF(READ_ONCE(p_curr->p_next));
+		}
+
+		if (p_curr->val >= val)
+			break;
+
+		p_prev = p_curr;
+		p_curr = p_next;
+	}
+
+	*pp_prev = p_prev;
+	*pp_curr = p_curr;
+}
+
+/*
+ * Check whether a value is in a list
+ *
+ * Does not help unlinking, so it never writes.
+ *
+ * Returns one if exists, zero else
+ */
+static int harris_list_contains(list_t *p_list, val_t val)
+{
+	node_t *p_node;
+	int result;
+
+	RCU_READER_LOCK();
+
+	p_node = (node_t *)RCU_DEREF(p_list->p_head);
+	while (p_node->val < val)
+		p_node = get_unmarked(RCU_DEREF(READ_ONCE(p_node->p_next)));
+
+	result = (p_node->val == val &&
+			!is_marked(READ_ONCE(p_node->p_next)));
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Insert a value into a list
+ *
+ * Returns one if inserted, zero if the value is in the list already.
+ */
+static int harris_list_add(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_curr;
+	node_t *p_new_node;
+	int result;
+
+	p_new_node = kmalloc(sizeof(node_t), GFP_KERNEL);
+	if (p_new_node == NULL)
+		return 0;
+	p_new_node->val = val;
+
+	RCU_READER_LOCK();
+
+	while (1) {
+		harris_search(p_list, val, &p_prev, &p_curr);
+
+		result = (p_curr->val != val);
+		if (!result)
+			break;
+
+		p_new_node->p_next = p_curr;
+		if (cmpxchg(&p_prev->p_next, p_curr, p_new_node) == p_curr)
+			break;
+	}
+
+	RCU_READER_UNLOCK();
+
+	if (!result)
+		kfree(p_new_node);
+	return result;
+}
+
+/*
+ * Delete a value from a list
+ *
+ * Marks the node first, which is the linearization point, and then tries
+ * unlinking it once.  A failed unlink is left to the next search.
+ *
+ * Returns one if deleted, zero if the list doesn't contain the value.
+ */
+static int harris_list_remove(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_curr, *p_next;
+	int result;
+
+	RCU_READER_LOCK();
+
+	while (1) {
+		harris_search(p_list, val, &p_prev, &p_curr);
+
+		result = (p_curr->val == val);
+		if (!result)
+			break;
+
+		p_next = (node_t *)RCU_DEREF(READ_ONCE(p_curr->p_next));
+		if (is_marked(p_next))
+			continue;
+		if (cmpxchg(&p_curr->p_next, p_next,
+					get_marked(p_next)) != p_next)
+			continue;
+
+		if (cmpxchg(&p_prev->p_next, p_curr, p_next) == p_curr)
+			RCU_FREE(p_curr);
+		else
+			harris_search(p_list, val, &p_prev, &p_curr);
+		break;
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+static void harris_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = get_unmarked(iter->p_next);
+		kfree(iter);
+	}
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global Harris-Michael hash list
+ */
+int harris_hash_list_init(int nr_buckets, void *dat)
+{
+	g_hash_list = rcu_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Destroy the global Harris-Michael hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void harris_hash_list_destroy(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		harris_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global Harris-Michael hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int harris_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return harris_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global Harris-Michael hash list
+ *
+ * Returns zero only
+ */
+int harris_hash_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	harris_list_add(g_hash_list->buckets[hash], val);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global Harris-Michael hash list
+ *
+ * Returns zero only
+ */
+int harris_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	harris_list_remove(g_hash_list->buckets[hash], val);
+	return 0;
+}
@@ -5,6 +5,9 @@
 // INCLUDES
 /////////////////////////////////////////////////////////
 #include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/prefetch.h>
+#include <linux/sort.h>
 
 /////////////////////////////////////////////////////////
 // DEFINES
@@ -20,11 +23,28 @@
 
 #define NR_NUMA_NODES (4)
 
+/* Maximum number of nodes unlinked by one rcx_numa_unlink_run() */
+#define RCX_RUN_MAX (16)
+
+/* Maximum number of keys per batched lookup */
+#define MAX_BATCH (64)
+/* Number of traversals interleaved by a batched lookup */
+#define AMAC_INFLIGHT (8)
+
 /////////////////////////////////////////////////////////
 // TYPES
 /////////////////////////////////////////////////////////
 typedef int val_t;
 
+/*
+ * Workload parameters given to the init function of a benchmark
+ */
+typedef struct bench_conf {
+	int range;		/* keys are in [0:range[ */
+	int ttl;		/* lifetime of an entry in ms, 0 for default */
+	int capacity;		/* most entries of a cache, zero for default */
+} bench_conf_t;
+
 typedef union aligned_spinlock {
 	spinlock_t __attribute__((aligned(CACHELINE_SIZE))) lock;
 	char padding[CACHELINE_SIZE];
@@ -36,6 +56,13 @@ typedef union node {
 		val_t val;
 		node_t *p_next;
 		int removed;
+		/*
+		 * optimistic version lock, odd while locked.  RCX bumps it
+		 * before changing p_next or removed.
+		 */
+		unsigned int version;
+		/* data of the value, changed by the conditional updates only */
+		val_t data;
 		struct rcu_head rcu;
 		/* per-NUMA node locks */
 		union {
@@ -72,6 +99,29 @@ typedef struct hash_list {
 	char *padding[CACHELINE_SIZE];
 } hash_list_t;
 
+/*
+ * Update applied by rcx_list_apply()
+ */
+#define RCX_OP_ADD	(0)
+#define RCX_OP_REMOVE	(1)
+
+typedef struct rcx_update {
+	val_t val;
+	int op;
+	int result;	/* one if the list changed */
+} rcx_update_t;
+
+/*
+ * Allocator of the sentinels of a list, for backends whose node starts with
+ * a node_t
+ */
+typedef node_t *(*rcx_alloc_t)(val_t val);
+
+/*
+ * Search fingers of a caller, opaque, see rcx-hash-list.c
+ */
+typedef struct finger finger_t;
+
 /////////////////////////////////////////////////////////
 // INTERFACE
 /////////////////////////////////////////////////////////
@@ -81,18 +131,29 @@ hash_list_t *rcx_new_hash_list(int n_buckets);
 
 int rcu_hash_list_init(int nr_buckets, void *dat);
 int rcu_hash_list_contains(void *tl, val_t val);
+void rcu_hash_list_read_begin(void *tl);
+void rcu_hash_list_read_end(void *tl);
+int rcu_hash_list_session_contains(void *tl, val_t val);
+int rcu_hash_list_contains_batch(void *tl, val_t *keys, int n, int *results);
+int rcu_hash_list_contains_merge(void *tl, val_t *keys, int n, int *results);
 int rcu_hash_list_add(void *tl, val_t val);
 int rcu_hash_list_remove(void *tl, val_t val);
 int rcu_hash_list_try_add(void *tl, val_t val);
 int rcu_hash_list_try_remove(void *tl, val_t val);
 int rcu_hash_list_fg_add(void *tl, val_t val);
 int rcu_hash_list_fg_remove(void *tl, val_t val);
+int rcu_hash_list_optlock_add(void *tl, val_t val);
+int rcu_hash_list_optlock_remove(void *tl, val_t val);
 int rcu_hash_list_numa_add(void *tl, val_t val);
 int rcu_hash_list_numa_remove(void *tl, val_t val);
 void rcu_hash_list_destroy(void);
 
 int rlu_hash_list_init(int nr_buckets, void *dat);
 int rlu_hash_list_contains(void *self, val_t val);
+void rlu_hash_list_read_begin(void *self);
+void rlu_hash_list_read_end(void *self);
+int rlu_hash_list_session_contains(void *self, val_t val);
+int rlu_hash_list_contains_batch(void *self, val_t *keys, int n, int *results);
 int rlu_hash_list_add(void *self, val_t val);
 int rlu_hash_list_remove(void *self, val_t val);
 int rlu_hash_list_try_add(void *self, val_t val);
@@ -101,6 +162,12 @@ void rlu_hash_list_destroy(void);
 
 int rcx_hash_list_init(int nr_buckets, void *dat);
 int rcx_hash_list_contains(void *tl, val_t val);
+void rcx_hash_list_read_begin(void *tl);
+void rcx_hash_list_read_end(void *tl);
+int rcx_hash_list_session_contains(void *tl, val_t val);
+int rcx_hash_list_contains_batch(void *tl, val_t *keys, int n, int *results);
+int rcx_hash_list_contains_merge(void *tl, val_t *keys, int n, int *results);
+int rcx_hash_list_contains_snapshot(void *tl, val_t *keys, int n, int *results);
 int rcx_hash_list_add(void *tl, val_t val);
 int rcx_hash_list_remove(void *tl, val_t val);
 int rcx_hash_list_try_add(void *tl, val_t val);
@@ -117,6 +184,312 @@ int rcx_hash_list_hhtmlock_add(void *tl, val_t val);
 int rcx_hash_list_hhtmlock_remove(void *tl, val_t val);
 int rcx_hash_list_numa_add(void *tl, val_t val);
 int rcx_hash_list_numa_remove(void *tl, val_t val);
+int rcx_hash_list_add_many(void *tl, val_t *vals, int n);
+int rcx_hash_list_remove_many(void *tl, val_t *vals, int n);
+int rcx_hash_list_rebuild(void *tl, rcx_update_t *updates, int n);
+int rcx_hash_list_txn(void *tl, rcx_update_t *updates, int n);
+int rcx_hash_list_move(void *tl, val_t from, val_t to);
+int rcx_hash_list_get_or_add(void *tl, val_t val, val_t data, val_t *p_data);
+int rcx_hash_list_compare_replace(void *tl, val_t val, val_t old_data,
+		val_t new_data);
+int rcx_hash_list_remove_if(void *tl, val_t val, val_t data);
+finger_t *rcx_hash_list_finger_new(void);
+void rcx_hash_list_finger_free(finger_t *finger);
+void rcx_hash_list_finger_reset(finger_t *finger);
+int rcx_hash_list_finger_contains(void *tl, val_t val, finger_t *finger);
+int rcx_hash_list_finger_add(void *tl, val_t val, finger_t *finger);
+int rcx_hash_list_finger_remove(void *tl, val_t val, finger_t *finger);
 void rcx_hash_list_destroy(void);
 
+int rcx_skip_list_init(int nr_buckets, void *dat);
+int rcx_skip_list_contains(void *tl, val_t val);
+int rcx_skip_list_add(void *tl, val_t val);
+int rcx_skip_list_remove(void *tl, val_t val);
+void rcx_skip_list_destroy(void);
+
+int rcx_adaptive_hash_list_init(int nr_buckets, void *dat);
+int rcx_adaptive_hash_list_contains(void *tl, val_t val);
+int rcx_adaptive_hash_list_add(void *tl, val_t val);
+int rcx_adaptive_hash_list_remove(void *tl, val_t val);
+void rcx_adaptive_hash_list_destroy(void);
+
+int rcx_oa_hash_init(int nr_buckets, void *dat);
+int rcx_oa_hash_contains(void *tl, val_t val);
+int rcx_oa_hash_add(void *tl, val_t val);
+int rcx_oa_hash_remove(void *tl, val_t val);
+void rcx_oa_hash_destroy(void);
+
+int rcx_cuckoo_hash_init(int nr_buckets, void *dat);
+int rcx_cuckoo_hash_contains(void *tl, val_t val);
+int rcx_cuckoo_hash_add(void *tl, val_t val);
+int rcx_cuckoo_hash_remove(void *tl, val_t val);
+void rcx_cuckoo_hash_destroy(void);
+
+int rcx_trie_init(int nr_buckets, void *dat);
+int rcx_trie_contains(void *tl, val_t val);
+int rcx_trie_add(void *tl, val_t val);
+int rcx_trie_remove(void *tl, val_t val);
+void rcx_trie_destroy(void);
+
+int harris_hash_list_init(int nr_buckets, void *dat);
+int harris_hash_list_contains(void *tl, val_t val);
+int harris_hash_list_add(void *tl, val_t val);
+int harris_hash_list_remove(void *tl, val_t val);
+void harris_hash_list_destroy(void);
+
+int rcx_fc_hash_list_init(int nr_buckets, void *dat);
+int rcx_fc_hash_list_contains(void *tl, val_t val);
+int rcx_fc_hash_list_add(void *tl, val_t val);
+int rcx_fc_hash_list_remove(void *tl, val_t val);
+void rcx_fc_hash_list_destroy(void);
+
+int rcx_deleg_hash_list_init(int nr_buckets, void *dat);
+int rcx_deleg_hash_list_contains(void *tl, val_t val);
+int rcx_deleg_hash_list_add(void *tl, val_t val);
+int rcx_deleg_hash_list_remove(void *tl, val_t val);
+void rcx_deleg_hash_list_destroy(void);
+
+int rcx_nr_hash_list_init(int nr_buckets, void *dat);
+int rcx_nr_hash_list_contains(void *tl, val_t val);
+int rcx_nr_hash_list_add(void *tl, val_t val);
+int rcx_nr_hash_list_remove(void *tl, val_t val);
+void rcx_nr_hash_list_destroy(void);
+
+int rcx_oplog_hash_list_init(int nr_buckets, void *dat);
+int rcx_oplog_hash_list_contains(void *tl, val_t val);
+int rcx_oplog_hash_list_add(void *tl, val_t val);
+int rcx_oplog_hash_list_remove(void *tl, val_t val);
+void rcx_oplog_hash_list_destroy(void);
+
+int rcx_elim_hash_list_init(int nr_buckets, void *dat);
+int rcx_elim_hash_list_contains(void *tl, val_t val);
+int rcx_elim_hash_list_add(void *tl, val_t val);
+int rcx_elim_hash_list_remove(void *tl, val_t val);
+void rcx_elim_hash_list_destroy(void);
+unsigned long rcx_elim_hash_list_nr_eliminated(void);
+
+int rcx_async_hash_list_init(int nr_buckets, void *dat);
+int rcx_async_hash_list_contains(void *tl, val_t val);
+int rcx_async_hash_list_add_async(void *tl, val_t val);
+int rcx_async_hash_list_remove_async(void *tl, val_t val);
+void rcx_async_hash_list_flush(void);
+void rcx_async_hash_list_destroy(void);
+
+int rcx_counter_hash_list_init(int nr_buckets, void *dat);
+int rcx_counter_hash_list_contains(void *tl, val_t val);
+int rcx_counter_hash_list_get(void *tl, val_t val, u64 *p_count);
+int rcx_counter_hash_list_add_count(void *tl, val_t val, u64 delta);
+int rcx_counter_hash_list_inc(void *tl, val_t val);
+int rcx_counter_hash_list_remove(void *tl, val_t val);
+void rcx_counter_hash_list_destroy(void);
+
+int rcx_ttl_hash_list_init(int nr_buckets, void *dat);
+int rcx_ttl_hash_list_contains(void *tl, val_t val);
+int rcx_ttl_hash_list_add(void *tl, val_t val);
+int rcx_ttl_hash_list_remove(void *tl, val_t val);
+void rcx_ttl_hash_list_destroy(void);
+
+int rcx_cache_hash_list_init(int nr_buckets, void *dat);
+int rcx_cache_hash_list_contains(void *tl, val_t val);
+int rcx_cache_hash_list_add(void *tl, val_t val);
+int rcx_cache_hash_list_remove(void *tl, val_t val);
+void rcx_cache_hash_list_destroy(void);
+
+/* RCX commit protocol, shared by the RCX-based backends */
+void rcx_init_node(node_t *p_new_node);
+node_t *rcx_new_node(void);
+void rcx_free_node(node_t *p_node);
+list_t *rcx_new_list(rcx_alloc_t alloc);
+node_t *rcx_list_find(list_t *p_list, val_t val, node_t **pp_next);
+int rcx_numa_lock(node_t **nodes, int nr);
+void rcx_numa_unlock(node_t **nodes, int nr);
+int rcx_numa_link(node_t *p_prev, node_t *p_next, node_t *p_new_node);
+int rcx_numa_unlink(node_t *p_prev, node_t *p_node, node_t *n);
+int rcx_numa_unlink_run(node_t *p_prev, node_t **run, int nr, node_t *n);
+void rcx_list_freeze(list_t *p_list);
+int rcx_list_contains(list_t *p_list, val_t val);
+int rcx_list_apply(list_t *p_list, rcx_update_t *updates, int nr);
+int rcx_list_numa_add_many(list_t *p_list, val_t *vals, int nr);
+int rcx_list_numa_remove_many(list_t *p_list, val_t *vals, int nr);
+int rcx_list_rebuild(list_t *p_list, rcx_update_t *updates, int nr);
+void rcx_free_chain(node_t *p_head);
+
+/////////////////////////////////////////////////////////
+// BATCHED LOOKUP
+/////////////////////////////////////////////////////////
+/*
+ * Dereference of a node pointer by the batched lookups, in the reader section
+ * of the backend
+ */
+typedef node_t *(*batch_deref_t)(void *tl, node_t *p_node);
+
+/*
+ * State of an in-flight traversal of hash_list_amac_contains()
+ */
+typedef struct amac_state {
+	int idx;		/* index in the batch, -1 if the slot is idle */
+	val_t val;
+	node_t *p_node;		/* node to be visited in the next round */
+} amac_state_t;
+
+static inline void amac_start(hash_list_t *p_hash_list, amac_state_t *st,
+		val_t *keys, int idx, batch_deref_t deref, void *tl)
+{
+	st->idx = idx;
+	st->val = keys[idx];
+	st->p_node = deref(tl, p_hash_list->buckets[
+			st->val % p_hash_list->n_buckets]->p_head);
+	prefetch(st->p_node);
+}
+
+/*
+ * Check whether each of given values is in a sorted-list hash list
+ *
+ * Traversals of up to AMAC_INFLIGHT keys are interleaved.  Each round advances
+ * every in-flight traversal by one node and prefetches the node it will visit
+ * in the next round, so the cache misses of different keys overlap instead of
+ * stalling one after another.  A slot that finished its traversal picks up the
+ * next key of the batch.  Only the dereference differs between backends, and
+ * since this is inlined with a constant deref, it costs no indirect call.
+ *
+ * Caller should be in the reader section of the backend.
+ *
+ * Stores zero to results[i] if keys[i] exists, -ENOENT else.  Returns the
+ * number of existing keys.
+ */
+static inline int hash_list_amac_contains(hash_list_t *p_hash_list,
+		val_t *keys, int n, int *results, batch_deref_t deref, void *tl)
+{
+	amac_state_t states[AMAC_INFLIGHT];
+	amac_state_t *st;
+	node_t *p_node;
+	int nr_inflight = 0;
+	int nr_found = 0;
+	int next = 0;
+	int i;
+
+	for (i = 0; i < AMAC_INFLIGHT; i++) {
+		st = &states[i];
+		if (next >= n) {
+			st->idx = -1;
+			continue;
+		}
+		amac_start(p_hash_list, st, keys, next++, deref, tl);
+		nr_inflight++;
+	}
+
+	while (nr_inflight) {
+		for (i = 0; i < AMAC_INFLIGHT; i++) {
+			st = &states[i];
+			if (st->idx < 0)
+				continue;
+
+			p_node = st->p_node;
+			if (p_node->val < st->val) {
+				st->p_node = deref(tl, p_node->p_next);
+				prefetch(st->p_node);
+				continue;
+			}
+
+			if (p_node->val == st->val) {
+				results[st->idx] = 0;
+				nr_found++;
+			} else {
+				results[st->idx] = -ENOENT;
+			}
+
+			if (next >= n) {
+				st->idx = -1;
+				nr_inflight--;
+				continue;
+			}
+			amac_start(p_hash_list, st, keys, next++, deref, tl);
+		}
+	}
+
+	return nr_found;
+}
+
+/*
+ * A key of a batched lookup, tagged with its bucket and position in the batch
+ */
+struct batch_probe {
+	int hash;
+	val_t val;
+	int idx;
+};
+
+static inline int batch_probe_cmp(const void *a, const void *b)
+{
+	const struct batch_probe *pa = a, *pb = b;
+
+	if (pa->hash != pb->hash)
+		return pa->hash < pb->hash ? -1 : 1;
+	if (pa->val != pb->val)
+		return pa->val < pb->val ? -1 : 1;
+	/* sort() is not stable, so keep the batch order of a value */
+	if (pa->idx != pb->idx)
+		return pa->idx < pb->idx ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Tag keys with their bucket and position, and sort them by bucket and value
+ */
+static inline void hash_list_sort_probes(hash_list_t *p_hash_list,
+		val_t *keys, int n, struct batch_probe *probes)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		probes[i].hash = keys[i] % p_hash_list->n_buckets;
+		probes[i].val = keys[i];
+		probes[i].idx = i;
+	}
+	sort(probes, n, sizeof(probes[0]), batch_probe_cmp, NULL);
+}
+
+/*
+ * Check whether each of given values is in a sorted-list hash list, walking
+ * each bucket only once
+ *
+ * The probes come from hash_list_sort_probes(), and all probes of a bucket are
+ * answered by a single merge-style pass over its sorted list.  With a few
+ * buckets and a large batch, this visits far fewer nodes than a walk per key.
+ *
+ * Caller should be in the reader section of the backend.
+ *
+ * Stores zero to results[idx] if the key of a probe exists, -ENOENT else.
+ * Returns the number of existing keys.
+ */
+static inline int hash_list_merge_contains(hash_list_t *p_hash_list,
+		struct batch_probe *probes, int n, int *results,
+		batch_deref_t deref, void *tl)
+{
+	node_t *p_node;
+	int nr_found = 0;
+	int hash;
+	int i = 0;
+
+	while (i < n) {
+		hash = probes[i].hash;
+		p_node = deref(tl, p_hash_list->buckets[hash]->p_head);
+
+		/* Probes of a bucket are sorted, so never walk back */
+		for (; i < n && probes[i].hash == hash; i++) {
+			while (p_node->val < probes[i].val)
+				p_node = deref(tl, p_node->p_next);
+
+			if (p_node->val == probes[i].val) {
+				results[probes[i].idx] = 0;
+				nr_found++;
+			} else {
+				results[probes[i].idx] = -ENOENT;
+			}
+		}
+	}
+
+	return nr_found;
+}
+
 #endif // _HASH_LIST_H_
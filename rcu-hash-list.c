@@ -35,6 +35,7 @@ node_t *rcu_new_node(void)
 		return NULL;
 
 	p_new_node->removed = 0;
+	p_new_node->version = 0;
 	for_each_node_with_cpus(nodeid)
 		pndslockof(p_new_node, nodeid) = __SPIN_LOCK_UNLOCKED(
 				pndslockof(p_new_node, nodeid));
@@ -130,19 +131,17 @@ static int hash_list_size(hash_list_t *p_hash_list)
 }
 
 /*
- * Check whether a list is containing a value
+ * Check whether a list is containing a value, in caller's RCU read-side
+ * critical section
  *
  * Returns one if containing, zero else
  */
-int rcu_list_contains(list_t *p_list, val_t val)
+static int rcu_list_lookup(list_t *p_list, val_t val)
 {
-	int result;
 	val_t v;
 	node_t *p_prev, *p_next;
 	node_t *p_node;
 
-	RCU_READER_LOCK();
-
 	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
 	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	while (1) {
@@ -156,8 +155,20 @@ int rcu_list_contains(list_t *p_list, val_t val)
 		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	}
 
-	result = (v == val);
+	return (v == val);
+}
+
+/*
+ * Check whether a list is containing a value
+ *
+ * Returns one if containing, zero else
+ */
+int rcu_list_contains(list_t *p_list, val_t val)
+{
+	int result;
 
+	RCU_READER_LOCK();
+	result = rcu_list_lookup(p_list, val);
 	RCU_READER_UNLOCK();
 
 	return result;
@@ -176,6 +187,83 @@ int rcu_hash_list_contains(void *tl, val_t val)
 		0 : -ENOENT;
 }
 
+/* Open a read-side session.  See rcx_hash_list_read_begin(). */
+void rcu_hash_list_read_begin(void *tl)
+{
+	RCU_READER_LOCK();
+}
+
+/* Close a read-side session opened by rcu_hash_list_read_begin() */
+void rcu_hash_list_read_end(void *tl)
+{
+	RCU_READER_UNLOCK();
+}
+
+/*
+ * Check whether a hash list is containing a value inside a read-side session
+ *
+ * Returns zero if containing, -ENOENT else
+ */
+int rcu_hash_list_session_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcu_list_lookup(g_hash_list->buckets[hash], val) ? 0 : -ENOENT;
+}
+
+static node_t *rcu_batch_deref(void *tl, node_t *p_node)
+{
+	return (node_t *)RCU_DEREF(p_node);
+}
+
+/*
+ * Check whether a hash list is containing each of given values
+ *
+ * Pipelines the traversals with hash_list_amac_contains().
+ *
+ * Stores zero to results[i] if containing keys[i], -ENOENT else.  Returns the
+ * number of contained keys.
+ */
+int rcu_hash_list_contains_batch(void *tl, val_t *keys, int n, int *results)
+{
+	int nr_found;
+
+	RCU_READER_LOCK();
+	nr_found = hash_list_amac_contains(g_hash_list, keys, n, results,
+			rcu_batch_deref, tl);
+	RCU_READER_UNLOCK();
+
+	return nr_found;
+}
+
+/*
+ * Check whether a hash list is containing each of given values, walking each
+ * bucket only once
+ *
+ * See rcx_hash_list_contains_merge() for the details.  At most MAX_BATCH keys
+ * can be given.
+ *
+ * Stores zero to results[i] if containing keys[i], -ENOENT else.  Returns the
+ * number of contained keys, or -EINVAL if too many keys are given.
+ */
+int rcu_hash_list_contains_merge(void *tl, val_t *keys, int n, int *results)
+{
+	struct batch_probe probes[MAX_BATCH];
+	int nr_found;
+
+	if (n > MAX_BATCH)
+		return -EINVAL;
+
+	hash_list_sort_probes(g_hash_list, keys, n, probes);
+
+	RCU_READER_LOCK();
+	nr_found = hash_list_merge_contains(g_hash_list, probes, n, results,
+			rcu_batch_deref, tl);
+	RCU_READER_UNLOCK();
+
+	return nr_found;
+}
+
 /*
  * Add a value into a list
  */
@@ -395,6 +483,153 @@ unlock_retry:
 	return result;
 }
 
+/*
+ * Versioned lock of a node, with the version seen by the traversal
+ */
+struct optlock {
+	node_t *p_node;
+	unsigned int version;
+};
+
+/*
+ * Read the version of a node before reading its fields
+ */
+static inline unsigned int optlock_version(node_t *p_node)
+{
+	unsigned int version = READ_ONCE(p_node->version);
+
+	smp_rmb();
+	return version;
+}
+
+/*
+ * Take the versioned locks of nodes in address order
+ *
+ * A lock is taken only if the version of its node is still the one seen by
+ * the traversal, so taking the locks validates everything the traversal read
+ * from the nodes.  A removed node stays locked, which fails the validation as
+ * well.
+ *
+ * Returns zero if all locked, -EAGAIN if any version changed.  Nothing is left
+ * locked in the latter case.
+ */
+static int optlock_lock(struct optlock *locks, int nr)
+{
+	struct optlock tmp;
+	int i, j;
+
+	for (i = 1; i < nr; i++) {
+		tmp = locks[i];
+		for (j = i; j > 0 && locks[j - 1].p_node > tmp.p_node; j--)
+			locks[j] = locks[j - 1];
+		locks[j] = tmp;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if ((locks[i].version & 1) ||
+				cmpxchg(&locks[i].p_node->version,
+					locks[i].version,
+					locks[i].version + 1) !=
+					locks[i].version)
+			goto unlock;
+	}
+
+	return 0;
+
+unlock:
+	/* Nothing changed, so the seen versions stay valid for others */
+	while (--i >= 0)
+		smp_store_release(&locks[i].p_node->version, locks[i].version);
+	return -EAGAIN;
+}
+
+/*
+ * Release a versioned lock
+ *
+ * A changed node gets a new version, and an unchanged one gets its seen
+ * version back so that concurrent traversals through it stay valid.
+ */
+static inline void optlock_unlock(struct optlock *lock, int changed)
+{
+	smp_store_release(&lock->p_node->version,
+			lock->version + (changed ? 2 : 0));
+}
+
+static inline struct optlock *optlock_of(struct optlock *locks, int nr,
+		node_t *p_node)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (locks[i].p_node == p_node)
+			return &locks[i];
+	return NULL;
+}
+
+/*
+ * Optimistic versioned locking version of rcu_list_fg_add()
+ *
+ * Takes the versioned locks of the predecessor and successor with CAS instead
+ * of their spinlocks, and the versions stand for re-reading p_next and
+ * removed.
+ *
+ * Returns one if inserted, zero if the value is in the list already.
+ */
+int rcu_list_optlock_add(list_t *p_list, val_t val)
+{
+	int result;
+	struct optlock locks[2];
+	unsigned int v_prev, v_next;
+	node_t *p_prev, *p_next;
+	node_t *p_new_node = NULL;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	v_prev = optlock_version(p_prev);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+
+	while (1) {
+		v_next = optlock_version(p_next);
+
+		if (p_next->val >= val)
+			break;
+
+		p_prev = p_next;
+		v_prev = v_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_next->val != val);
+
+	if (result) {
+		if (p_new_node == NULL)
+			p_new_node = rcu_new_node();
+		p_new_node->val = val;
+		p_new_node->p_next = p_next;
+
+		locks[0] = (struct optlock){p_prev, v_prev};
+		locks[1] = (struct optlock){p_next, v_next};
+		if (optlock_lock(locks, 2)) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+
+		RCU_ASSIGN_PTR((p_prev->p_next), p_new_node);
+
+		optlock_unlock(optlock_of(locks, 2, p_next), 0);
+		optlock_unlock(optlock_of(locks, 2, p_prev), 1);
+		p_new_node = NULL;
+	}
+
+	RCU_READER_UNLOCK();
+
+	if (p_new_node)
+		kfree(p_new_node);
+	return result;
+}
+
 /*
  * Insert a value into the global hash list
  *
@@ -443,6 +678,19 @@ int rcu_hash_list_numa_add(void *tl, val_t val)
 	return rcu_list_numa_add(g_hash_list->buckets[hash], val);
 }
 
+/*
+ * Optimistic versioned locking version of rcu_hash_list_fg_add()
+ *
+ * Returns zero always
+ */
+int rcu_hash_list_optlock_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	rcu_list_optlock_add(g_hash_list->buckets[hash], val);
+	return 0;
+}
+
 /*
  * Delete a value from a list
  *
@@ -668,6 +916,65 @@ unlock_retry:
 	return result;
 }
 
+/*
+ * Optimistic versioned locking version of rcu_list_fg_remove()
+ *
+ * The removed node is never unlocked, so later lockers of it fail in the same
+ * way as on a version change.
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcu_list_optlock_remove(list_t *p_list, val_t val)
+{
+	int result;
+	struct optlock locks[3];
+	unsigned int v_prev, v_node, v_n;
+	node_t *p_prev, *p_next;
+	node_t *n;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	v_prev = optlock_version(p_prev);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		v_node = optlock_version(p_next);
+
+		if (p_next->val >= val)
+			break;
+
+		p_prev = p_next;
+		v_prev = v_node;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_next->val == val);
+
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		v_n = optlock_version(n);
+
+		locks[0] = (struct optlock){p_prev, v_prev};
+		locks[1] = (struct optlock){p_next, v_node};
+		locks[2] = (struct optlock){n, v_n};
+		if (optlock_lock(locks, 3)) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+
+		RCU_ASSIGN_PTR((p_prev->p_next), n);
+		p_next->removed = 1;
+
+		optlock_unlock(optlock_of(locks, 3, n), 0);
+		optlock_unlock(optlock_of(locks, 3, p_prev), 1);
+		rcu_free_node(p_next);
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
 /*
  * Remove a value from the global hash list
  *
@@ -716,6 +1023,19 @@ int rcu_hash_list_numa_remove(void *tl, val_t val)
 	return rcu_list_numa_remove(g_hash_list->buckets[hash], val);
 }
 
+/*
+ * Optimistic versioned locking version of rcu_hash_list_fg_remove()
+ *
+ * Returns zero always
+ */
+int rcu_hash_list_optlock_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	rcu_list_optlock_remove(g_hash_list->buckets[hash], val);
+	return 0;
+}
+
 static void rcu_list_destroy(list_t *list)
 {
 	node_t *iter;
@@ -0,0 +1,527 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+#define RCU_ASSIGN_PTR(p_ptr, p_obj)    rcu_assign_pointer(p_ptr, p_obj)
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+/*
+ * Each bucket is either an RCX list or a sorted array of values.  The array
+ * is published through the list_t head pointer with its low bit set, so a
+ * reader learns the representation from the same load that starts its
+ * lookup.  Updates to an array are copy-on-write and serialized by the
+ * bucket mutex.
+ */
+#define ADAPT_ARRAY_TAG		(1UL)
+
+/* One of (1 << ADAPT_*_SHIFT) accesses is counted, with that weight */
+#define ADAPT_READ_SHIFT	(6)
+#define ADAPT_WRITE_SHIFT	(3)
+/* Number of counted accesses a bucket decides its representation over */
+#define ADAPT_WINDOW		(8192)
+/* A list becomes an array when it sees this many reads per write... */
+#define ADAPT_TO_ARRAY_RATIO	(32)
+/* ...and an array becomes a list again below this many reads per write */
+#define ADAPT_TO_LIST_RATIO	(8)
+/* Largest bucket that is converted to an array */
+#define ADAPT_MAX_ARRAY		(4096)
+
+typedef struct sorted_array {
+	struct rcu_head rcu;
+	int nr;
+	val_t vals[];
+} sorted_array_t;
+
+typedef struct adapt_bucket {
+	/* Serializes array updates and representation changes */
+	struct mutex lock;
+	atomic_t nr_reads;
+	atomic_t nr_writes;
+} ____cacheline_aligned adapt_bucket_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static adapt_bucket_t *g_adapt_buckets;
+
+static DEFINE_PER_CPU(unsigned int, adapt_tick);
+
+#define is_array(p_head)	((unsigned long)(p_head) & ADAPT_ARRAY_TAG)
+#define array_of(p_head)	\
+	((sorted_array_t *)((unsigned long)(p_head) & ~ADAPT_ARRAY_TAG))
+#define array_head(p_array)	\
+	((node_t *)((unsigned long)(p_array) | ADAPT_ARRAY_TAG))
+
+
+/**************************
+ * Sorted Array
+ **************************/
+
+static sorted_array_t *array_alloc(int nr, gfp_t flags)
+{
+	sorted_array_t *p_array;
+
+	p_array = kmalloc(sizeof(sorted_array_t) + nr * sizeof(val_t), flags);
+	if (p_array == NULL)
+		return NULL;
+
+	p_array->nr = nr;
+	return p_array;
+}
+
+/*
+ * Find the index of the first value not less than val
+ */
+static int array_lower_bound(sorted_array_t *p_array, val_t val)
+{
+	int lo = 0;
+	int hi = p_array->nr;
+	int mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (p_array->vals[mid] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int array_contains(sorted_array_t *p_array, val_t val)
+{
+	int i = array_lower_bound(p_array, val);
+
+	return i < p_array->nr && p_array->vals[i] == val;
+}
+
+static node_t *adapt_new_node(val_t val, node_t *p_next)
+{
+	node_t *p_new_node = kmalloc(sizeof(node_t), GFP_KERNEL | __GFP_NOFAIL);
+
+	rcx_init_node(p_new_node);
+	p_new_node->val = val;
+	p_new_node->p_next = p_next;
+
+	return p_new_node;
+}
+
+/*
+ * Replace an array bucket with a list
+ *
+ * Caller should hold the bucket mutex.
+ */
+static void array_to_list(list_t *p_list)
+{
+	sorted_array_t *p_array = array_of(p_list->p_head);
+	node_t *p_node;
+	int i;
+
+	p_node = adapt_new_node(LIST_VAL_MAX, NULL);
+	for (i = p_array->nr - 1; i >= 0; i--)
+		p_node = adapt_new_node(p_array->vals[i], p_node);
+	p_node = adapt_new_node(LIST_VAL_MIN, p_node);
+
+	RCU_ASSIGN_PTR(p_list->p_head, p_node);
+	kfree_rcu(p_array, rcu);
+}
+
+/*
+ * Insert or delete a value in an array bucket
+ *
+ * Copies the array with the change applied and publishes the copy.  The old
+ * array is freed after a grace period.  If the copy cannot be allocated, the
+ * bucket is made a list, whose updates allocate nodes that cannot fail.
+ *
+ * Returns one if the bucket changed, zero if not, or -EAGAIN if the bucket is
+ * a list now.
+ */
+static int array_update(list_t *p_list, adapt_bucket_t *p_bucket,
+		val_t val, int add)
+{
+	node_t *p_head;
+	sorted_array_t *p_array, *p_new_array;
+	int i, found;
+	int result = 0;
+
+	mutex_lock(&p_bucket->lock);
+
+	p_head = p_list->p_head;
+	if (!is_array(p_head)) {
+		result = -EAGAIN;
+		goto unlock;
+	}
+
+	p_array = array_of(p_head);
+	i = array_lower_bound(p_array, val);
+	found = (i < p_array->nr && p_array->vals[i] == val);
+	if (found == add)
+		goto unlock;
+
+	p_new_array = array_alloc(p_array->nr + (add ? 1 : -1), GFP_KERNEL);
+	if (p_new_array == NULL) {
+		array_to_list(p_list);
+		result = -EAGAIN;
+		goto unlock;
+	}
+
+	memcpy(p_new_array->vals, p_array->vals, i * sizeof(val_t));
+	if (add) {
+		p_new_array->vals[i] = val;
+		memcpy(&p_new_array->vals[i + 1], &p_array->vals[i],
+				(p_array->nr - i) * sizeof(val_t));
+	} else {
+		memcpy(&p_new_array->vals[i], &p_array->vals[i + 1],
+				(p_array->nr - i - 1) * sizeof(val_t));
+	}
+
+	RCU_ASSIGN_PTR(p_list->p_head, array_head(p_new_array));
+	kfree_rcu(p_array, rcu);
+	result = 1;
+
+unlock:
+	mutex_unlock(&p_bucket->lock);
+	return result;
+}
+
+
+/**************************
+ * Representation Changes
+ **************************/
+
+/*
+ * Replace a list bucket with a sorted array
+ *
+ * The list is frozen first, so the RCX updaters in flight retry and find the
+ * array.  Caller should hold the bucket mutex.
+ */
+static void list_to_array(list_t *p_list)
+{
+	node_t *p_head = p_list->p_head;
+	node_t *p_node;
+	sorted_array_t *p_array;
+	int nr = 0;
+
+	/* Sentinels are not counted */
+	RCU_READER_LOCK();
+	for (p_node = p_head->p_next; p_node->p_next; p_node = p_node->p_next)
+		if (++nr > ADAPT_MAX_ARRAY)
+			break;
+	RCU_READER_UNLOCK();
+	if (nr > ADAPT_MAX_ARRAY)
+		return;
+
+	rcx_list_freeze(p_list);
+
+	/* The frozen list cannot change, so count it again exactly */
+	nr = 0;
+	for (p_node = p_head->p_next; p_node->p_next; p_node = p_node->p_next)
+		nr++;
+
+	/* A frozen list cannot stay published, so this must not fail */
+	p_array = array_alloc(nr, GFP_KERNEL | __GFP_NOFAIL);
+
+	nr = 0;
+	for (p_node = p_head->p_next; p_node->p_next; p_node = p_node->p_next)
+		p_array->vals[nr++] = p_node->val;
+
+	RCU_ASSIGN_PTR(p_list->p_head, array_head(p_array));
+	rcx_free_chain(p_head);
+}
+
+/*
+ * Pick the representation of a bucket from its recent read/write mix
+ */
+static void adapt_decide(list_t *p_list, adapt_bucket_t *p_bucket)
+{
+	int reads, writes;
+
+	if (!mutex_trylock(&p_bucket->lock))
+		return;
+
+	reads = atomic_xchg(&p_bucket->nr_reads, 0);
+	writes = atomic_xchg(&p_bucket->nr_writes, 0);
+
+	if (!is_array(p_list->p_head)) {
+		if (reads >= ADAPT_TO_ARRAY_RATIO * writes)
+			list_to_array(p_list);
+	} else {
+		if (reads < ADAPT_TO_LIST_RATIO * writes)
+			array_to_list(p_list);
+	}
+
+	mutex_unlock(&p_bucket->lock);
+}
+
+/*
+ * Count a sample of the accesses to a bucket
+ *
+ * Should be called out of the read-side critical section, since it may
+ * change the representation of the bucket.
+ */
+static void adapt_account(list_t *p_list, adapt_bucket_t *p_bucket, int write)
+{
+	unsigned int shift = write ? ADAPT_WRITE_SHIFT : ADAPT_READ_SHIFT;
+	int nr;
+
+	if (this_cpu_inc_return(adapt_tick) & ((1U << shift) - 1))
+		return;
+
+	if (write)
+		nr = atomic_add_return(1 << shift, &p_bucket->nr_writes) +
+			atomic_read(&p_bucket->nr_reads);
+	else
+		nr = atomic_add_return(1 << shift, &p_bucket->nr_reads) +
+			atomic_read(&p_bucket->nr_writes);
+
+	if (nr >= ADAPT_WINDOW)
+		adapt_decide(p_list, p_bucket);
+}
+
+
+/**************************
+ * Bucket
+ **************************/
+
+/*
+ * Check whether a value is in a bucket
+ *
+ * Returns one if exists, zero else
+ */
+static int adapt_contains(list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_head, *p_node;
+
+	RCU_READER_LOCK();
+
+	p_head = (node_t *)RCU_DEREF(p_list->p_head);
+	if (is_array(p_head)) {
+		result = array_contains(array_of(p_head), val);
+	} else {
+		p_node = (node_t *)RCU_DEREF(p_head->p_next);
+		while (p_node->val < val)
+			p_node = (node_t *)RCU_DEREF(p_node->p_next);
+		result = (p_node->val == val);
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Insert a value into a bucket
+ *
+ * Returns one if inserted, zero if the value is in the bucket already.
+ */
+static int adapt_add(list_t *p_list, adapt_bucket_t *p_bucket, val_t val)
+{
+	int result;
+	node_t *p_head, *p_prev, *p_next;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_head = (node_t *)RCU_DEREF(p_list->p_head);
+	if (is_array(p_head)) {
+		RCU_READER_UNLOCK();
+		result = array_update(p_list, p_bucket, val, 1);
+		if (result == -EAGAIN)
+			goto retry;
+		return result;
+	}
+
+	p_prev = p_head;
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_next->val < val) {
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_next->val != val);
+
+	if (result) {
+		node_t *p_new_node = adapt_new_node(val, p_next);
+
+		if (rcx_numa_link(p_prev, p_next, p_new_node)) {
+			RCU_READER_UNLOCK();
+			kfree(p_new_node);
+			goto retry;
+		}
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Delete a value from a bucket
+ *
+ * Returns one if deleted, zero if the bucket doesn't contain the value.
+ */
+static int adapt_remove(list_t *p_list, adapt_bucket_t *p_bucket, val_t val)
+{
+	int result;
+	node_t *p_head, *p_prev, *p_next;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_head = (node_t *)RCU_DEREF(p_list->p_head);
+	if (is_array(p_head)) {
+		RCU_READER_UNLOCK();
+		result = array_update(p_list, p_bucket, val, 0);
+		if (result == -EAGAIN)
+			goto retry;
+		return result;
+	}
+
+	p_prev = p_head;
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_next->val < val) {
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_next->val == val);
+
+	if (result) {
+		if (rcx_numa_unlink(p_prev, p_next,
+					(node_t *)RCU_DEREF(p_next->p_next))) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+		kfree_rcu(p_next, rcu);
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+static void adapt_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	if (is_array(p_list->p_head)) {
+		kfree(array_of(p_list->p_head));
+		return;
+	}
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global adaptive hash list
+ *
+ * All buckets start as lists.
+ */
+int rcx_adaptive_hash_list_init(int nr_buckets, void *dat)
+{
+	int i;
+
+	g_adapt_buckets = kmalloc(nr_buckets * sizeof(adapt_bucket_t),
+			GFP_KERNEL);
+	if (g_adapt_buckets == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_buckets; i++) {
+		mutex_init(&g_adapt_buckets[i].lock);
+		atomic_set(&g_adapt_buckets[i].nr_reads, 0);
+		atomic_set(&g_adapt_buckets[i].nr_writes, 0);
+	}
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL) {
+		kfree(g_adapt_buckets);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Destroy the global adaptive hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_adaptive_hash_list_destroy(void)
+{
+	int hash;
+
+	/* Chains and arrays replaced by conversions are still in call_rcu */
+	rcu_barrier();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		adapt_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+	kfree(g_adapt_buckets);
+}
+
+/*
+ * Check whether a value is in the global adaptive hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_adaptive_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	list_t *p_list = g_hash_list->buckets[hash];
+	int result;
+
+	result = adapt_contains(p_list, val);
+	adapt_account(p_list, &g_adapt_buckets[hash], 0);
+
+	return result ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global adaptive hash list
+ *
+ * Returns zero only
+ */
+int rcx_adaptive_hash_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	list_t *p_list = g_hash_list->buckets[hash];
+
+	adapt_add(p_list, &g_adapt_buckets[hash], val);
+	adapt_account(p_list, &g_adapt_buckets[hash], 1);
+
+	return 0;
+}
+
+/*
+ * Deletes a value from the global adaptive hash list
+ *
+ * Returns zero only
+ */
+int rcx_adaptive_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	list_t *p_list = g_hash_list->buckets[hash];
+
+	adapt_remove(p_list, &g_adapt_buckets[hash], val);
+	adapt_account(p_list, &g_adapt_buckets[hash], 1);
+
+	return 0;
+}
@@ -0,0 +1,393 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/topology.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+/* Updates queued per ring, a power of two */
+#define ASYNC_RING_SIZE		(1024)
+/* Most updates a worker applies in one round */
+#define ASYNC_BATCH		(4096)
+/* Empty rounds before a worker sleeps for a jiffy */
+#define ASYNC_IDLE_ROUNDS	(64)
+
+typedef struct async_entry {
+	val_t val;
+	int op;
+} async_entry_t;
+
+typedef struct async_worker async_worker_t;
+
+/*
+ * Update ring of a set of tasks
+ *
+ * A task always queues into the same ring, picked by its pid, so its updates
+ * are in program order in the ring wherever it runs.  The tasks of a ring
+ * queue under its lock, and one worker drains it.  The head moves only after
+ * the updates before it are applied.
+ */
+typedef struct async_ring {
+	spinlock_t __attribute__((aligned(CACHELINE_SIZE))) lock;
+	unsigned long tail;
+	unsigned long __attribute__((aligned(CACHELINE_SIZE))) head;
+	unsigned long taken;	/* taken by the worker in this round */
+	async_worker_t *p_worker;
+	async_entry_t entries[ASYNC_RING_SIZE];
+} async_ring_t;
+
+/*
+ * Update taken from a ring, with its order among the updates of its ring
+ */
+typedef struct async_batch_entry {
+	val_t val;
+	int op;
+	unsigned long seq;
+} async_batch_entry_t;
+
+/*
+ * Worker of a NUMA node, serving the rings allocated on its node
+ */
+struct async_worker {
+	struct task_struct *task;
+	async_batch_entry_t batch[ASYNC_BATCH];
+	rcx_update_t updates[ASYNC_BATCH];
+};
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+/* One ring per possible cpu, shared round-robin by the workers */
+static async_ring_t **g_rings;
+static int g_nr_rings;
+static async_worker_t *g_workers[NR_NUMA_NODES];
+
+/*
+ * Order batch entries by bucket, then value, then submission
+ */
+static int async_entry_cmp(const void *a, const void *b)
+{
+	const async_batch_entry_t *p_a = a;
+	const async_batch_entry_t *p_b = b;
+	int hash_a = HASH_VALUE(g_hash_list, p_a->val);
+	int hash_b = HASH_VALUE(g_hash_list, p_b->val);
+
+	if (hash_a != hash_b)
+		return hash_a < hash_b ? -1 : 1;
+	if (p_a->val != p_b->val)
+		return p_a->val < p_b->val ? -1 : 1;
+	if (p_a->seq != p_b->seq)
+		return p_a->seq < p_b->seq ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Apply one round of queued updates
+ *
+ * The updates taken from all rings of the node are sorted by bucket, and each
+ * bucket is updated in one rcx_list_apply() traversal.  Only the last update of
+ * a value matters in a set, so the others are dropped.  The updates of a task
+ * are in one ring, so they keep their program order.  Updates of different
+ * rings are not ordered among themselves, as they come from different tasks.
+ *
+ * Returns the number of updates taken.
+ */
+static int async_apply_round(async_worker_t *p_worker)
+{
+	async_ring_t *p_ring;
+	async_batch_entry_t *p_entry;
+	unsigned long idx;
+	int nr = 0, nr_entries, nr_updates;
+	int ring, i, hash;
+
+	for (ring = 0; ring < g_nr_rings; ring++) {
+		p_ring = g_rings[ring];
+		if (p_ring->p_worker != p_worker)
+			continue;
+
+		p_ring->taken = smp_load_acquire(&p_ring->tail);
+		for (idx = p_ring->head; idx != p_ring->taken; idx++) {
+			if (nr == ASYNC_BATCH) {
+				p_ring->taken = idx;
+				break;
+			}
+			p_entry = &p_worker->batch[nr++];
+			p_entry->val = p_ring->entries[idx &
+				(ASYNC_RING_SIZE - 1)].val;
+			p_entry->op = p_ring->entries[idx &
+				(ASYNC_RING_SIZE - 1)].op;
+			p_entry->seq = idx;
+		}
+	}
+
+	if (nr == 0)
+		return 0;
+
+	sort(p_worker->batch, nr, sizeof(async_batch_entry_t),
+			async_entry_cmp, NULL);
+
+	for (i = 0; i < nr; i += nr_entries) {
+		hash = HASH_VALUE(g_hash_list, p_worker->batch[i].val);
+		nr_entries = 1;
+		while (i + nr_entries < nr && HASH_VALUE(g_hash_list,
+				p_worker->batch[i + nr_entries].val) == hash)
+			nr_entries++;
+
+		nr_updates = 0;
+		for (p_entry = &p_worker->batch[i];
+				p_entry < &p_worker->batch[i + nr_entries];
+				p_entry++) {
+			if (p_entry + 1 < &p_worker->batch[i + nr_entries] &&
+					(p_entry + 1)->val == p_entry->val)
+				continue;
+			p_worker->updates[nr_updates].val = p_entry->val;
+			p_worker->updates[nr_updates].op = p_entry->op;
+			nr_updates++;
+		}
+		rcx_list_apply(g_hash_list->buckets[hash], p_worker->updates,
+				nr_updates);
+	}
+
+	/* Free the slots, and complete the updates for flushers */
+	for (ring = 0; ring < g_nr_rings; ring++) {
+		p_ring = g_rings[ring];
+		if (p_ring->p_worker == p_worker)
+			smp_store_release(&p_ring->head, p_ring->taken);
+	}
+
+	return nr;
+}
+
+static int async_thread(void *arg)
+{
+	async_worker_t *p_worker = arg;
+	int nr_idle_rounds = 0;
+
+	while (!kthread_should_stop()) {
+		if (async_apply_round(p_worker)) {
+			nr_idle_rounds = 0;
+			cond_resched();
+			continue;
+		}
+
+		if (++nr_idle_rounds < ASYNC_IDLE_ROUNDS) {
+			cpu_relax();
+			continue;
+		}
+		nr_idle_rounds = 0;
+		schedule_timeout_interruptible(1);
+	}
+
+	return 0;
+}
+
+/*
+ * Queue an update into the ring of this task
+ *
+ * Waits for the worker only if the ring is full.
+ */
+static void async_submit(val_t val, int op)
+{
+	async_ring_t *p_ring = g_rings[current->pid % g_nr_rings];
+	unsigned long tail;
+
+	while (1) {
+		spin_lock(&p_ring->lock);
+		tail = p_ring->tail;
+		if (tail - smp_load_acquire(&p_ring->head) < ASYNC_RING_SIZE)
+			break;
+		spin_unlock(&p_ring->lock);
+		cond_resched();
+	}
+
+	p_ring->entries[tail & (ASYNC_RING_SIZE - 1)].val = val;
+	p_ring->entries[tail & (ASYNC_RING_SIZE - 1)].op = op;
+	smp_store_release(&p_ring->tail, tail + 1);
+	spin_unlock(&p_ring->lock);
+}
+
+static void async_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+static void async_stop(void)
+{
+	int i;
+
+	for (i = 0; i < NR_NUMA_NODES; i++) {
+		if (g_workers[i] && g_workers[i]->task)
+			kthread_stop(g_workers[i]->task);
+		kfree(g_workers[i]);
+		g_workers[i] = NULL;
+	}
+
+	for (i = 0; i < g_nr_rings; i++)
+		kfree(g_rings[i]);
+	kfree(g_rings);
+	g_rings = NULL;
+	g_nr_rings = 0;
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global asynchronous hash list
+ *
+ * One ring per possible cpu, and one worker per NUMA node with cpus, bound to
+ * the cpus of its node.  The rings are dealt to the workers in turn, and each
+ * is allocated on the node of its worker.  Workers take cpu time from the
+ * benchmark threads.
+ */
+int rcx_async_hash_list_init(int nr_buckets, void *dat)
+{
+	async_worker_t *p_worker;
+	async_ring_t *p_ring;
+	struct task_struct *t;
+	int i, node;
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	for_each_node_with_cpus(node) {
+		if (node >= NR_NUMA_NODES)
+			break;
+		p_worker = kzalloc_node(sizeof(async_worker_t), GFP_KERNEL,
+				node);
+		if (p_worker == NULL)
+			goto fail;
+		g_workers[node] = p_worker;
+	}
+
+	for (node = 0; node < NR_NUMA_NODES; node++)
+		if (g_workers[node])
+			break;
+	if (node == NR_NUMA_NODES)
+		goto fail;
+
+	g_rings = kcalloc(num_possible_cpus(), sizeof(async_ring_t *),
+			GFP_KERNEL);
+	if (g_rings == NULL)
+		goto fail;
+
+	node = 0;
+	for (i = 0; i < num_possible_cpus(); i++) {
+		while (g_workers[node] == NULL)
+			node = (node + 1) % NR_NUMA_NODES;
+
+		p_ring = kzalloc_node(sizeof(async_ring_t), GFP_KERNEL, node);
+		if (p_ring == NULL)
+			goto fail;
+		spin_lock_init(&p_ring->lock);
+		p_ring->p_worker = g_workers[node];
+		g_rings[g_nr_rings++] = p_ring;
+		node = (node + 1) % NR_NUMA_NODES;
+	}
+
+	for (node = 0; node < NR_NUMA_NODES; node++) {
+		p_worker = g_workers[node];
+		if (p_worker == NULL)
+			continue;
+
+		t = kthread_create_on_node(async_thread, p_worker, node,
+				"rcx_async/%d", node);
+		if (IS_ERR(t))
+			goto fail;
+		set_cpus_allowed_ptr(t, cpumask_of_node(node));
+		p_worker->task = t;
+		wake_up_process(t);
+	}
+
+	return 0;
+
+fail:
+	rcx_async_hash_list_destroy();
+	return -ENOMEM;
+}
+
+/*
+ * Destroy the global asynchronous hash list
+ *
+ * Queued updates are applied first.  Caller of this function should guarantee
+ * that there is no other concurrent threads accessing it.
+ */
+void rcx_async_hash_list_destroy(void)
+{
+	int hash;
+
+	rcx_async_hash_list_flush();
+	async_stop();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		async_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global asynchronous hash list
+ *
+ * Updates still queued are not seen.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_async_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Queues an insert into the global asynchronous hash list
+ *
+ * Returns zero only
+ */
+int rcx_async_hash_list_add_async(void *tl, val_t val)
+{
+	async_submit(val, RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Queues a delete from the global asynchronous hash list
+ *
+ * Returns zero only
+ */
+int rcx_async_hash_list_remove_async(void *tl, val_t val)
+{
+	async_submit(val, RCX_OP_REMOVE);
+	return 0;
+}
+
+/*
+ * Wait until every update queued before the call is applied
+ */
+void rcx_async_hash_list_flush(void)
+{
+	async_ring_t *p_ring;
+	unsigned long tail;
+	int ring;
+
+	for (ring = 0; ring < g_nr_rings; ring++) {
+		p_ring = g_rings[ring];
+		tail = smp_load_acquire(&p_ring->tail);
+		while ((long)(smp_load_acquire(&p_ring->head) - tail) < 0)
+			cond_resched();
+	}
+}
@@ -0,0 +1,371 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+/* Share of the key range cached if the bench_conf_t doesn't give a capacity */
+#define CACHE_DEFAULT_SHIFT	(2)
+/* Most nodes the hand passes per eviction, to bound the insert latency */
+#define CACHE_EVICT_SCAN	(1024)
+
+/*
+ * Cached node
+ *
+ * The list of nodes is a plain RCX list of node_t.  Lookups set the
+ * reference bit without any lock, and only if it is clear, so a hot entry
+ * costs no write.  The CLOCK hand clears it, and evicts an entry it finds
+ * clear, which has not been looked up for a full turn of the hand.
+ */
+typedef struct cache_node {
+	node_t node;
+	int referenced;
+} cache_node_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static long g_capacity;
+/* Exact, so the capacity holds however many cpus insert */
+__cacheline_aligned static atomic_long_t g_nr_entries;
+
+/*
+ * CLOCK hand, the bucket and the last value it passed.  Only the updater
+ * holding the lock moves it, and the others leave the eviction to it.
+ */
+static DEFINE_MUTEX(g_hand_lock);
+static int g_hand_hash;
+static val_t g_hand_val;
+
+#define cache_of(p_node)	container_of(p_node, cache_node_t, node)
+
+/*
+ * Allocate a cached node
+ */
+static cache_node_t *cache_new_node(val_t val)
+{
+	cache_node_t *p_new_node = kmalloc(sizeof(cache_node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	rcx_init_node(&p_new_node->node);
+	p_new_node->node.val = val;
+	p_new_node->referenced = 0;
+
+	return p_new_node;
+}
+
+/*
+ * Allocate a sentinel of a list of cached nodes, for rcx_new_list()
+ */
+static node_t *cache_alloc_node(val_t val)
+{
+	cache_node_t *p_new_node = cache_new_node(val);
+
+	return p_new_node ? &p_new_node->node : NULL;
+}
+
+static void cache_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(cache_of(iter));
+	}
+}
+
+/*
+ * Move the hand through one bucket from the value after g_hand_val
+ *
+ * Clears the reference bits it passes, and evicts the nodes found clear until
+ * nr_evict are evicted.  A node whose unlink conflicts is passed over.  Caller
+ * should hold the hand lock.
+ *
+ * Returns the number of nodes passed, and the number evicted in *p_evicted.
+ */
+static int cache_hand_list(list_t *p_list, int nr_evict, int *p_evicted)
+{
+	node_t *p_prev, *p_node;
+	cache_node_t *p_cache;
+	int nr_passed = 0;
+
+	*p_evicted = 0;
+
+	RCU_READER_LOCK();
+
+	if (g_hand_val == LIST_VAL_MIN)
+		p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	else
+		p_prev = rcx_list_find(p_list, g_hand_val + 1, &p_node);
+	p_node = (node_t *)RCU_DEREF(p_prev->p_next);
+
+	while (p_node->p_next && *p_evicted < nr_evict &&
+			nr_passed < CACHE_EVICT_SCAN) {
+		p_cache = cache_of(p_node);
+		nr_passed++;
+		g_hand_val = p_node->val;
+
+		if (READ_ONCE(p_cache->referenced)) {
+			WRITE_ONCE(p_cache->referenced, 0);
+		} else if (rcx_numa_unlink(p_prev, p_node,
+				(node_t *)RCU_DEREF(p_node->p_next)) == 0) {
+			atomic_long_dec(&g_nr_entries);
+			kfree_rcu(p_cache, node.rcu);
+			(*p_evicted)++;
+			/* p_prev stays, and the hand goes on from it */
+			p_node = (node_t *)RCU_DEREF(p_prev->p_next);
+			continue;
+		}
+
+		p_prev = p_node;
+		p_node = (node_t *)RCU_DEREF(p_node->p_next);
+	}
+
+	/* Wrap to the next bucket at the end of this one */
+	if (p_node->p_next == NULL) {
+		g_hand_hash = (g_hand_hash + 1) % g_hash_list->n_buckets;
+		g_hand_val = LIST_VAL_MIN;
+	}
+
+	RCU_READER_UNLOCK();
+	return nr_passed;
+}
+
+/*
+ * Evict entries until the cache is within its capacity
+ *
+ * Runs on the updater that pushed the cache over, unless another updater
+ * holds the hand already.  Such an updater leaves its eviction to the holder,
+ * so the holder checks the count again after it lets the hand go, and evicts
+ * again if the cache went over meanwhile.  The hand passes at most
+ * CACHE_EVICT_SCAN nodes per turn, and a turn that ends on that bound is the
+ * last, so the cache may stay over its capacity until the next insert.
+ */
+static void cache_evict(void)
+{
+	int nr_passed, nr_evicted;
+	long nr_over;
+
+	do {
+		if (!mutex_trylock(&g_hand_lock))
+			return;
+
+		nr_passed = 0;
+		while (nr_passed < CACHE_EVICT_SCAN) {
+			nr_over = atomic_long_read(&g_nr_entries) - g_capacity;
+			if (nr_over <= 0)
+				break;
+
+			nr_passed += cache_hand_list(
+					g_hash_list->buckets[g_hand_hash],
+					nr_over, &nr_evicted);
+			/* An empty bucket still counts, to bound the turn */
+			nr_passed++;
+		}
+
+		mutex_unlock(&g_hand_lock);
+	} while (nr_passed < CACHE_EVICT_SCAN &&
+			atomic_long_read(&g_nr_entries) > g_capacity);
+}
+
+/*
+ * Insert a value into a list
+ *
+ * Returns one if inserted, zero if the value is in the list already, or
+ * -ENOMEM.
+ */
+static int cache_list_add(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_next;
+	cache_node_t *p_new_node;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val == val) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	p_new_node = cache_new_node(val);
+	if (p_new_node == NULL) {
+		RCU_READER_UNLOCK();
+		return -ENOMEM;
+	}
+	p_new_node->node.p_next = p_next;
+
+	if (rcx_numa_link(p_prev, p_next, &p_new_node->node)) {
+		RCU_READER_UNLOCK();
+		kfree(p_new_node);
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+/*
+ * Delete a value from a list
+ *
+ * Returns one if success, zero if the list doesn't contain the value.
+ */
+static int cache_list_remove(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_next;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val != val) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	if (rcx_numa_unlink(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next))) {
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+	kfree_rcu(cache_of(p_next), node.rcu);
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global bounded cache
+ *
+ * The capacity in entries comes from the bench_conf_t given as dat.  If it is
+ * zero, a quarter of the key range is cached.
+ */
+int rcx_cache_hash_list_init(int nr_buckets, void *dat)
+{
+	bench_conf_t *p_conf = dat;
+	int i;
+
+	g_capacity = p_conf->capacity ? p_conf->capacity :
+		max(p_conf->range >> CACHE_DEFAULT_SHIFT, 1);
+	atomic_long_set(&g_nr_entries, 0);
+
+	g_hash_list = kmalloc(sizeof(hash_list_t), GFP_KERNEL);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	g_hash_list->n_buckets = nr_buckets;
+	for (i = 0; i < g_hash_list->n_buckets; i++) {
+		g_hash_list->buckets[i] = rcx_new_list(cache_alloc_node);
+		if (g_hash_list->buckets[i] == NULL) {
+			g_hash_list->n_buckets = i;
+			rcx_cache_hash_list_destroy();
+			return -ENOMEM;
+		}
+	}
+
+	g_hand_hash = 0;
+	g_hand_val = LIST_VAL_MIN;
+
+	return 0;
+}
+
+/*
+ * Destroy the global bounded cache
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_cache_hash_list_destroy(void)
+{
+	int hash;
+
+	/* Removed nodes may be freed with kfree_rcu() still */
+	rcu_barrier();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		cache_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global bounded cache
+ *
+ * Marks the value referenced, for the CLOCK hand.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_cache_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	cache_node_t *p_cache;
+	node_t *p_next;
+	int result;
+
+	RCU_READER_LOCK();
+
+	rcx_list_find(g_hash_list->buckets[hash], val, &p_next);
+	result = (p_next->val == val);
+	if (result) {
+		p_cache = cache_of(p_next);
+		if (!READ_ONCE(p_cache->referenced))
+			WRITE_ONCE(p_cache->referenced, 1);
+	}
+
+	RCU_READER_UNLOCK();
+
+	return result ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global bounded cache
+ *
+ * Evicts unreferenced entries if the cache goes over its capacity.
+ *
+ * Returns zero, or -ENOMEM
+ */
+int rcx_cache_hash_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	int ret;
+
+	ret = cache_list_add(g_hash_list->buckets[hash], val);
+	if (ret <= 0)
+		return ret;
+
+	if (atomic_long_inc_return(&g_nr_entries) > g_capacity)
+		cache_evict();
+
+	return 0;
+}
+
+/*
+ * Deletes a value from the global bounded cache
+ *
+ * Returns zero only
+ */
+int rcx_cache_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	if (cache_list_remove(g_hash_list->buckets[hash], val))
+		atomic_long_dec(&g_nr_entries);
+
+	return 0;
+}
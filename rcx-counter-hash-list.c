@@ -0,0 +1,388 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/percpu.h>
+
+
+#include "hash-list.h"
+#include "rtm.h"
+#include "rtm_debug.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+#define RCU_WRITER_LOCK(lock)           spin_lock(&lock)
+#define RCU_WRITER_UNLOCK(lock)         spin_unlock(&lock)
+
+/* HTM attempts of an increment before it takes the global lock of the node */
+#define COUNTER_HTM_RETRY_LIMIT	(4)
+/* Conflicting increments after which a counter is split per cpu */
+#define COUNTER_HOT_CONFLICTS	(64)
+
+/*
+ * Counter node
+ *
+ * The list of nodes is a plain RCX list of node_t, so counters are created
+ * and deleted with the RCX protocol.  The count is incremented in an HTM
+ * region, or under the global lock of the node, which is what deletes take
+ * too.  Once increments of a counter keep conflicting, it gets a per-cpu
+ * split, and the value of the counter is the count plus the sum of the split.
+ */
+typedef struct counter_node {
+	node_t node;
+	u64 count;
+	u64 __percpu *split;
+	atomic_t nr_conflicts;
+} counter_node_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+
+#define counter_of(p_node)	container_of(p_node, counter_node_t, node)
+
+/*
+ * Allocate a counter node
+ */
+static counter_node_t *counter_new_node(val_t val, u64 count)
+{
+	counter_node_t *p_new_node;
+
+	p_new_node = kmalloc(sizeof(counter_node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	rcx_init_node(&p_new_node->node);
+	p_new_node->node.val = val;
+	p_new_node->count = count;
+	p_new_node->split = NULL;
+	atomic_set(&p_new_node->nr_conflicts, 0);
+
+	return p_new_node;
+}
+
+static void counter_free_node(counter_node_t *p_node)
+{
+	free_percpu(p_node->split);
+	kfree(p_node);
+}
+
+static void counter_free_rcu(struct rcu_head *rcu)
+{
+	counter_free_node(container_of(rcu, counter_node_t, node.rcu));
+}
+
+/*
+ * Allocate a sentinel of a list of counters, for rcx_new_list()
+ */
+static node_t *counter_alloc_node(val_t val)
+{
+	counter_node_t *p_new_node = counter_new_node(val, 0);
+
+	return p_new_node ? &p_new_node->node : NULL;
+}
+
+static void counter_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		counter_free_node(counter_of(iter));
+	}
+}
+
+/*
+ * Give a hot counter its per-cpu split
+ *
+ * Racing splitters agree through the cmpxchg, and the loser frees its copy.
+ */
+static void counter_split(counter_node_t *p_counter)
+{
+	u64 __percpu *split = alloc_percpu(u64);
+
+	if (split == NULL)
+		return;
+	if (cmpxchg(&p_counter->split, NULL, split) != NULL)
+		free_percpu(split);
+}
+
+/*
+ * Add to a counter in the list
+ *
+ * A split counter is added to on this cpu only.  Otherwise the count is added
+ * to in an HTM region which elides the global lock of the node, and under the
+ * lock after COUNTER_HTM_RETRY_LIMIT aborts.  A deleted node is never added
+ * to, so no increment is lost to a concurrent delete.
+ *
+ * Returns zero if added, -ENOENT if the counter is deleted.
+ */
+static int counter_add(counter_node_t *p_counter, u64 delta)
+{
+	node_t *p_node = &p_counter->node;
+	u64 __percpu *split;
+	unsigned int tx_stat;
+	int ret = 0;
+	int i;
+
+	split = READ_ONCE(p_counter->split);
+	if (split) {
+		/*
+		 * A delete marks removed before a grace period frees the
+		 * split
+		 */
+		if (READ_ONCE(p_node->removed))
+			return -ENOENT;
+		this_cpu_add(*split, delta);
+		return 0;
+	}
+
+	for (i = 0; i < COUNTER_HTM_RETRY_LIMIT; i++) {
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(&p_node->global_lock))
+				_xabort(ABORT_CONFLICT);
+			if (p_node->removed)
+				_xabort(ABORT_DOUBLE_FREE);
+			p_counter->count += delta;
+			_xend();
+			return 0;
+		}
+
+		record_abort(tx_stat);
+		if ((tx_stat & _XABORT_EXPLICIT) &&
+				_XABORT_CODE(tx_stat) == ABORT_DOUBLE_FREE)
+			return -ENOENT;
+		if (tx_stat & _XABORT_CAPACITY)
+			break;
+	}
+
+	if (atomic_inc_return(&p_counter->nr_conflicts) ==
+			COUNTER_HOT_CONFLICTS)
+		counter_split(p_counter);
+
+	RCU_WRITER_LOCK(p_node->global_lock);
+	if (p_node->removed)
+		ret = -ENOENT;
+	else
+		p_counter->count += delta;
+	RCU_WRITER_UNLOCK(p_node->global_lock);
+
+	return ret;
+}
+
+/*
+ * Read a counter
+ *
+ * The split is summed without stopping increments, so the value is exact only
+ * if no increment is concurrent.
+ */
+static u64 counter_read(counter_node_t *p_counter)
+{
+	u64 __percpu *split = READ_ONCE(p_counter->split);
+	u64 count = READ_ONCE(p_counter->count);
+	int cpu;
+
+	if (split)
+		for_each_possible_cpu(cpu)
+			count += *per_cpu_ptr(split, cpu);
+
+	return count;
+}
+
+/*
+ * Add to the counter of a value in a list, creating it on first touch
+ *
+ * A new counter starts from delta, and is linked by the commit step of
+ * rcx_list_numa_add().
+ *
+ * Returns zero, or -ENOMEM if a new counter can't be allocated.
+ */
+static int counter_list_add(list_t *p_list, val_t val, u64 delta)
+{
+	node_t *p_prev, *p_next;
+	counter_node_t *p_new_node;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val == val) {
+		if (counter_add(counter_of(p_next), delta)) {
+			/* Deleted meanwhile, so create it again */
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	p_new_node = counter_new_node(val, delta);
+	if (p_new_node == NULL) {
+		RCU_READER_UNLOCK();
+		return -ENOMEM;
+	}
+	p_new_node->node.p_next = p_next;
+
+	if (rcx_numa_link(p_prev, p_next, &p_new_node->node)) {
+		RCU_READER_UNLOCK();
+		kfree(p_new_node);
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 0;
+}
+
+/*
+ * Delete the counter of a value from a list
+ *
+ * Returns one if deleted, zero if the list doesn't contain the value.
+ */
+static int counter_list_remove(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_next;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val != val) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	if (rcx_numa_unlink(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next))) {
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+	call_rcu(&p_next->rcu, counter_free_rcu);
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global counter hash list
+ */
+int rcx_counter_hash_list_init(int nr_buckets, void *dat)
+{
+	int i;
+
+	g_hash_list = kmalloc(sizeof(hash_list_t), GFP_KERNEL);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	g_hash_list->n_buckets = nr_buckets;
+	for (i = 0; i < g_hash_list->n_buckets; i++) {
+		g_hash_list->buckets[i] = rcx_new_list(counter_alloc_node);
+		if (g_hash_list->buckets[i] == NULL) {
+			g_hash_list->n_buckets = i;
+			rcx_counter_hash_list_destroy();
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Destroy the global counter hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_counter_hash_list_destroy(void)
+{
+	int hash;
+
+	/* Deleted counters may be freed with call_rcu() still */
+	rcu_barrier();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		counter_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Read the counter of a value in the global counter hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_counter_hash_list_get(void *tl, val_t val, u64 *p_count)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	node_t *p_next;
+	int ret = -ENOENT;
+
+	RCU_READER_LOCK();
+
+	rcx_list_find(g_hash_list->buckets[hash], val, &p_next);
+	if (p_next->val == val) {
+		*p_count = counter_read(counter_of(p_next));
+		ret = 0;
+	}
+
+	RCU_READER_UNLOCK();
+	return ret;
+}
+
+/*
+ * Check whether a value has a counter in the global counter hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_counter_hash_list_contains(void *tl, val_t val)
+{
+	u64 count;
+
+	return rcx_counter_hash_list_get(tl, val, &count);
+}
+
+/*
+ * Adds to the counter of a value in the global counter hash list
+ *
+ * The counter is created on first touch.
+ *
+ * Returns zero, or -ENOMEM
+ */
+int rcx_counter_hash_list_add_count(void *tl, val_t val, u64 delta)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return counter_list_add(g_hash_list->buckets[hash], val, delta);
+}
+
+/*
+ * Increments the counter of a value in the global counter hash list
+ *
+ * Returns zero, or -ENOMEM
+ */
+int rcx_counter_hash_list_inc(void *tl, val_t val)
+{
+	return rcx_counter_hash_list_add_count(tl, val, 1);
+}
+
+/*
+ * Deletes the counter of a value from the global counter hash list
+ *
+ * Returns zero only
+ */
+int rcx_counter_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	counter_list_remove(g_hash_list->buckets[hash], val);
+	return 0;
+}
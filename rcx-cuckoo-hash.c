@@ -0,0 +1,534 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/mm.h>    // kvmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/random.h>
+
+
+#include "hash-list.h"
+#include "rtm.h"
+#include "rtm_debug.h"
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_WRITER_LOCK(lock)           spin_lock(&lock)
+#define RCU_WRITER_UNLOCK(lock)         spin_unlock(&lock)
+
+#define CK_EMPTY		(LIST_VAL_MIN)
+/* A bucket is one cache line, with its version in the same line */
+#define CK_SLOTS		((CACHELINE_SIZE - sizeof(u32)) / sizeof(val_t))
+
+/* Longest displacement path, in moved values */
+#define CK_MAX_PATH		(8)
+/* Number of random walks tried to find a displacement path */
+#define CK_SEARCH_TRIES		(16)
+/* Number of transactions tried before taking the stripe locks */
+#define CK_HTM_RETRY_LIMIT	(10)
+/* Number of optimistic probes of a miss before taking the stripe locks */
+#define CK_READ_RETRY_LIMIT	(16)
+#define CK_NR_STRIPES		(256)
+
+/*
+ * Bucket of the cuckoo table
+ *
+ * The version is even while the bucket is stable.  Transactions add two to it
+ * when they change the bucket, and the locking fallback holds it odd while it
+ * changes the bucket.  Transactions abort on an odd version, which makes the
+ * version the lock subscription of the bucket as well.
+ */
+typedef struct ck_bucket {
+	u32 version;
+	val_t slots[CK_SLOTS];
+} __attribute__((aligned(CACHELINE_SIZE))) ck_bucket_t;
+
+typedef struct ck_table {
+	unsigned int bucket_bits;
+	unsigned long n_buckets;
+	ck_bucket_t *buckets;
+	aligned_spinlock_t stripes[CK_NR_STRIPES];
+} ck_table_t;
+
+/*
+ * One step of a displacement path
+ *
+ * The value in the slot moves to the next step, which is a slot of its other
+ * bucket.  The last step is the free slot.
+ */
+typedef struct ck_step {
+	unsigned long bucket;
+	int slot;
+	val_t val;
+} ck_step_t;
+
+__cacheline_aligned static ck_table_t *g_ck_table;
+
+static inline unsigned long ck_hash1(ck_table_t *p_table, val_t val)
+{
+	return hash_32(val, p_table->bucket_bits);
+}
+
+/*
+ * Get the other bucket of a value
+ *
+ * The two buckets of a value differ in a non-zero mask taken from the value,
+ * so either one gives the other one.
+ */
+static inline unsigned long ck_alt(ck_table_t *p_table, val_t val,
+		unsigned long bucket)
+{
+	return bucket ^ (hash_32(~val, p_table->bucket_bits) | 1);
+}
+
+static int ck_find(ck_bucket_t *p_bucket, val_t val)
+{
+	int i;
+
+	for (i = 0; i < CK_SLOTS; i++)
+		if (READ_ONCE(p_bucket->slots[i]) == val)
+			return i;
+	return -1;
+}
+
+static inline u32 ck_read_begin(ck_bucket_t *p_bucket)
+{
+	u32 version = READ_ONCE(p_bucket->version);
+
+	smp_rmb();
+	return version;
+}
+
+/*
+ * Whether a read of a bucket since ck_read_begin() may be inconsistent
+ *
+ * Returns true if the version was odd or has changed.
+ */
+static inline int ck_read_retry(ck_bucket_t *p_bucket, u32 version)
+{
+	smp_rmb();
+	return (version & 1) || READ_ONCE(p_bucket->version) != version;
+}
+
+/*
+ * Search a displacement path for a new value
+ *
+ * Random walks from one of the two buckets of the value, moving a random
+ * value of each full bucket to its other bucket, until a bucket with a free
+ * slot.  The search runs without locks, and the path is validated when it is
+ * committed.
+ *
+ * Returns the number of steps, or zero if no path was found.
+ */
+static int ck_search_path(ck_table_t *p_table, val_t val, ck_step_t *path)
+{
+	unsigned long bucket;
+	ck_bucket_t *p_bucket;
+	int try, depth, i, slot;
+
+	for (try = 0; try < CK_SEARCH_TRIES; try++) {
+		bucket = ck_hash1(p_table, val);
+		if (try & 1)
+			bucket = ck_alt(p_table, val, bucket);
+
+		for (depth = 0; depth <= CK_MAX_PATH; depth++) {
+			/* A bucket visited twice would move a value twice */
+			for (i = 0; i < depth; i++)
+				if (path[i].bucket == bucket)
+					break;
+			if (i < depth)
+				break;
+
+			p_bucket = &p_table->buckets[bucket];
+			slot = ck_find(p_bucket, CK_EMPTY);
+			if (slot >= 0) {
+				path[depth].bucket = bucket;
+				path[depth].slot = slot;
+				path[depth].val = CK_EMPTY;
+				return depth + 1;
+			}
+
+			slot = prandom_u32_max(CK_SLOTS);
+			path[depth].bucket = bucket;
+			path[depth].slot = slot;
+			path[depth].val = READ_ONCE(p_bucket->slots[slot]);
+			if (path[depth].val == CK_EMPTY)
+				break;
+			bucket = ck_alt(p_table, path[depth].val, bucket);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check that nobody changed a path or inserted the value since the search
+ */
+static int ck_validate_path(ck_table_t *p_table, val_t val,
+		ck_step_t *path, int len)
+{
+	unsigned long h1 = ck_hash1(p_table, val);
+	int i;
+
+	if (ck_find(&p_table->buckets[h1], val) >= 0 ||
+			ck_find(&p_table->buckets[ck_alt(p_table, val, h1)],
+				val) >= 0)
+		return 0;
+
+	for (i = 0; i < len; i++)
+		if (p_table->buckets[path[i].bucket].slots[path[i].slot] !=
+				path[i].val)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Move the values along a path and put the new value in the first slot
+ */
+static void ck_apply_path(ck_table_t *p_table, val_t val,
+		ck_step_t *path, int len)
+{
+	int i;
+
+	for (i = len - 1; i > 0; i--)
+		WRITE_ONCE(p_table->buckets[path[i].bucket].slots[path[i].slot],
+				path[i - 1].val);
+	WRITE_ONCE(p_table->buckets[path[0].bucket].slots[path[0].slot], val);
+}
+
+/*
+ * Collect the sorted stripes of a set of buckets
+ *
+ * Returns the number of distinct stripes.
+ */
+static int ck_stripes(unsigned long *buckets, int nr, int *stripes)
+{
+	int i, j, n = 0;
+	int stripe;
+
+	for (i = 0; i < nr; i++) {
+		stripe = buckets[i] % CK_NR_STRIPES;
+		for (j = 0; j < n && stripes[j] < stripe; j++)
+			;
+		if (j < n && stripes[j] == stripe)
+			continue;
+
+		memmove(&stripes[j + 1], &stripes[j], (n - j) * sizeof(int));
+		stripes[j] = stripe;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Lock a set of buckets for the locking fallback
+ *
+ * The stripes are taken in ascending order, and then the version of each
+ * bucket is made odd to abort the transactions and readers on it.
+ */
+static void ck_lock(ck_table_t *p_table, unsigned long *buckets, int nr,
+		int *stripes, int nr_stripes)
+{
+	int i;
+
+	for (i = 0; i < nr_stripes; i++)
+		RCU_WRITER_LOCK(p_table->stripes[stripes[i]].lock);
+	for (i = 0; i < nr; i++) {
+		ck_bucket_t *p_bucket = &p_table->buckets[buckets[i]];
+
+		/* A bucket may be listed twice */
+		if (!(p_bucket->version & 1))
+			WRITE_ONCE(p_bucket->version, p_bucket->version + 1);
+	}
+	smp_wmb();
+}
+
+static void ck_unlock(ck_table_t *p_table, unsigned long *buckets, int nr,
+		int *stripes, int nr_stripes)
+{
+	int i;
+
+	smp_wmb();
+	for (i = 0; i < nr; i++) {
+		ck_bucket_t *p_bucket = &p_table->buckets[buckets[i]];
+
+		if (p_bucket->version & 1)
+			WRITE_ONCE(p_bucket->version, p_bucket->version + 1);
+	}
+	for (i = nr_stripes - 1; i >= 0; i--)
+		RCU_WRITER_UNLOCK(p_table->stripes[stripes[i]].lock);
+}
+
+/*
+ * Check whether a value is in the table
+ *
+ * Lock-free but for the fallback below, and touches only the two buckets of
+ * the value.  A slot holds a value only while it is in the table, since a move
+ * writes its new slot before it clears the old one, so a hit needs no
+ * validation.  A miss could be a value moving between the buckets under the
+ * lookup, so it is validated against the versions of both, and probed again
+ * on a writer in flight.
+ *
+ * After CK_READ_RETRY_LIMIT probes the miss is decided under the stripe locks
+ * of both buckets, so a lookup waits at most for the locking writers ahead of
+ * it instead of spinning as long as the buckets keep changing.
+ *
+ * Returns one if exists, zero else
+ */
+static int ck_contains(ck_table_t *p_table, val_t val)
+{
+	unsigned long buckets[2];
+	int stripes[2];
+	int nr_stripes;
+	ck_bucket_t *p_b1, *p_b2;
+	u32 v1, v2;
+	int result;
+	int retry;
+
+	buckets[0] = ck_hash1(p_table, val);
+	buckets[1] = ck_alt(p_table, val, buckets[0]);
+	p_b1 = &p_table->buckets[buckets[0]];
+	p_b2 = &p_table->buckets[buckets[1]];
+
+	RCU_READER_LOCK();
+	for (retry = 0; retry < CK_READ_RETRY_LIMIT; retry++) {
+		v1 = ck_read_begin(p_b1);
+		v2 = ck_read_begin(p_b2);
+		result = (ck_find(p_b1, val) >= 0 || ck_find(p_b2, val) >= 0);
+		if (result || (!ck_read_retry(p_b1, v1) &&
+					!ck_read_retry(p_b2, v2))) {
+			RCU_READER_UNLOCK();
+			return result;
+		}
+	}
+	RCU_READER_UNLOCK();
+
+	/* The odd versions keep the transactions off both buckets */
+	nr_stripes = ck_stripes(buckets, 2, stripes);
+	ck_lock(p_table, buckets, 2, stripes, nr_stripes);
+	result = (ck_find(p_b1, val) >= 0 || ck_find(p_b2, val) >= 0);
+	ck_unlock(p_table, buckets, 2, stripes, nr_stripes);
+
+	return result;
+}
+
+/*
+ * Insert a value into the table
+ *
+ * A free slot in either bucket is a displacement path of one step.  The whole
+ * path commits in one transaction, which aborts on any odd version it reads,
+ * and falls back to locking the stripes of every bucket on the path.
+ *
+ * Returns one if inserted, zero if the value is in the table already or no
+ * free slot was found.
+ */
+static int ck_add(ck_table_t *p_table, val_t val)
+{
+	unsigned long h1 = ck_hash1(p_table, val);
+	unsigned long buckets[CK_MAX_PATH + 3];
+	int stripes[CK_MAX_PATH + 3];
+	ck_step_t path[CK_MAX_PATH + 1];
+	int nr_stripes;
+	int tx_stat;
+	int retry;
+	int len;
+	int i;
+
+	for (retry = 0; retry < CK_HTM_RETRY_LIMIT; retry++) {
+		if (ck_contains(p_table, val))
+			return 0;
+		len = ck_search_path(p_table, val, path);
+		if (len == 0)
+			return 0;
+
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if ((p_table->buckets[h1].version |
+					p_table->buckets[ck_alt(p_table, val,
+						h1)].version) & 1)
+				_xabort(ABORT_LF_CONFLICT);
+			for (i = 0; i < len; i++)
+				if (p_table->buckets[path[i].bucket].version &
+						1)
+					_xabort(ABORT_LF_CONFLICT);
+			if (!ck_validate_path(p_table, val, path, len))
+				_xabort(ABORT_CONFLICT);
+
+			ck_apply_path(p_table, val, path, len);
+			for (i = 0; i < len; i++)
+				p_table->buckets[path[i].bucket].version += 2;
+			_xend();
+			return 1;
+		}
+		record_abort(tx_stat);
+	}
+
+	while (1) {
+		if (ck_contains(p_table, val))
+			return 0;
+		len = ck_search_path(p_table, val, path);
+		if (len == 0)
+			return 0;
+
+		buckets[0] = h1;
+		buckets[1] = ck_alt(p_table, val, h1);
+		for (i = 0; i < len; i++)
+			buckets[i + 2] = path[i].bucket;
+		nr_stripes = ck_stripes(buckets, len + 2, stripes);
+
+		ck_lock(p_table, buckets, len + 2, stripes, nr_stripes);
+		if (ck_validate_path(p_table, val, path, len)) {
+			ck_apply_path(p_table, val, path, len);
+			ck_unlock(p_table, buckets, len + 2, stripes,
+					nr_stripes);
+			return 1;
+		}
+		ck_unlock(p_table, buckets, len + 2, stripes, nr_stripes);
+	}
+}
+
+/*
+ * Delete a value from the table
+ *
+ * Returns one if deleted, zero if the table doesn't contain the value.
+ */
+static int ck_remove(ck_table_t *p_table, val_t val)
+{
+	unsigned long buckets[2];
+	int stripes[2];
+	int nr_stripes;
+	ck_bucket_t *p_bucket;
+	int tx_stat;
+	int retry;
+	int i, slot;
+
+	buckets[0] = ck_hash1(p_table, val);
+	buckets[1] = ck_alt(p_table, val, buckets[0]);
+
+	for (retry = 0; retry < CK_HTM_RETRY_LIMIT; retry++) {
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			for (i = 0; i < 2; i++) {
+				p_bucket = &p_table->buckets[buckets[i]];
+				if (p_bucket->version & 1)
+					_xabort(ABORT_LF_CONFLICT);
+				slot = ck_find(p_bucket, val);
+				if (slot >= 0) {
+					p_bucket->slots[slot] = CK_EMPTY;
+					p_bucket->version += 2;
+					_xend();
+					return 1;
+				}
+			}
+			_xend();
+			return 0;
+		}
+		record_abort(tx_stat);
+	}
+
+	nr_stripes = ck_stripes(buckets, 2, stripes);
+	ck_lock(p_table, buckets, 2, stripes, nr_stripes);
+	for (i = 0; i < 2; i++) {
+		p_bucket = &p_table->buckets[buckets[i]];
+		slot = ck_find(p_bucket, val);
+		if (slot >= 0) {
+			WRITE_ONCE(p_bucket->slots[slot], CK_EMPTY);
+			break;
+		}
+	}
+	ck_unlock(p_table, buckets, 2, stripes, nr_stripes);
+
+	return i < 2;
+}
+
+
+/**************************
+ * Hash Table
+ **************************/
+
+/*
+ * Setup the global cuckoo table
+ *
+ * The table has a slot for every key in the range of the bench_conf_t given
+ * as dat.  nr_buckets is not used.
+ */
+int rcx_cuckoo_hash_init(int nr_buckets, void *dat)
+{
+	bench_conf_t *p_conf = dat;
+	unsigned long i;
+	int j;
+
+	g_ck_table = kmalloc(sizeof(ck_table_t), GFP_KERNEL);
+	if (g_ck_table == NULL)
+		return -ENOMEM;
+
+	/* ck_alt() needs at least one bit */
+	g_ck_table->n_buckets = max(roundup_pow_of_two(
+				DIV_ROUND_UP(max(p_conf->range, 1), CK_SLOTS)),
+			2UL);
+	g_ck_table->bucket_bits = ilog2(g_ck_table->n_buckets);
+
+	g_ck_table->buckets = kvmalloc(g_ck_table->n_buckets *
+			sizeof(ck_bucket_t), GFP_KERNEL);
+	if (g_ck_table->buckets == NULL) {
+		kfree(g_ck_table);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < g_ck_table->n_buckets; i++) {
+		g_ck_table->buckets[i].version = 0;
+		for (j = 0; j < CK_SLOTS; j++)
+			g_ck_table->buckets[i].slots[j] = CK_EMPTY;
+	}
+	for (j = 0; j < CK_NR_STRIPES; j++)
+		spin_lock_init(&g_ck_table->stripes[j].lock);
+
+	return 0;
+}
+
+/*
+ * Destroy the global cuckoo table
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_cuckoo_hash_destroy(void)
+{
+	kvfree(g_ck_table->buckets);
+	kfree(g_ck_table);
+}
+
+/*
+ * Check whether a value is in the global cuckoo table
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_cuckoo_hash_contains(void *tl, val_t val)
+{
+	return ck_contains(g_ck_table, val) ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global cuckoo table
+ *
+ * Returns zero only
+ */
+int rcx_cuckoo_hash_add(void *tl, val_t val)
+{
+	ck_add(g_ck_table, val);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global cuckoo table
+ *
+ * Returns zero only
+ */
+int rcx_cuckoo_hash_remove(void *tl, val_t val)
+{
+	ck_remove(g_ck_table, val);
+	return 0;
+}
@@ -0,0 +1,289 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/topology.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+/* Messages in flight from one NUMA node to another */
+#define DELEG_RING_SIZE		(64)
+
+/*
+ * Request message, one cache line
+ *
+ * The slot sequence says the state of the message for the ticket t a sender
+ * took: t is free, t + 1 filled by the sender, t + 2 done by the delegate, and
+ * the sender frees it for the next round with t + DELEG_RING_SIZE.
+ */
+typedef struct deleg_msg {
+	unsigned int seq;
+	int op;
+	val_t val;
+	int result;
+} __attribute__((aligned(CACHELINE_SIZE))) deleg_msg_t;
+
+/*
+ * Ring of requests from the threads of one NUMA node to the delegate of
+ * another.  Allocated on the node of the delegate.
+ */
+typedef struct deleg_ring {
+	/* Taken by the senders */
+	atomic_t __attribute__((aligned(CACHELINE_SIZE))) tail;
+	/* Moved by the delegate */
+	unsigned int __attribute__((aligned(CACHELINE_SIZE))) head;
+	deleg_msg_t msgs[DELEG_RING_SIZE];
+} deleg_ring_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+
+/* NUMA nodes with cpus, one delegate on each */
+static int g_deleg_nodes[NR_NUMA_NODES];
+static int g_nr_deleg_nodes;
+static struct task_struct *g_delegates[NR_NUMA_NODES];
+/* Rings indexed by the node of the delegate and the node of the sender */
+static deleg_ring_t *g_rings[NR_NUMA_NODES][NR_NUMA_NODES];
+
+static inline int deleg_home(int hash)
+{
+	return g_deleg_nodes[hash % g_nr_deleg_nodes];
+}
+
+/*
+ * Apply one update to its bucket on the local node
+ */
+static int deleg_apply(val_t val, int op)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	rcx_update_t update = {.val = val, .op = op};
+
+	rcx_list_apply(g_hash_list->buckets[hash], &update, 1);
+	return update.result;
+}
+
+/*
+ * Ship an update to the delegate of its home node and wait for the result
+ */
+static int deleg_ship(deleg_ring_t *p_ring, val_t val, int op)
+{
+	unsigned int ticket = atomic_inc_return(&p_ring->tail) - 1;
+	deleg_msg_t *p_msg = &p_ring->msgs[ticket % DELEG_RING_SIZE];
+	int result;
+
+	while (smp_load_acquire(&p_msg->seq) != ticket)
+		cpu_relax();
+
+	p_msg->op = op;
+	p_msg->val = val;
+	smp_store_release(&p_msg->seq, ticket + 1);
+
+	while (smp_load_acquire(&p_msg->seq) != ticket + 2)
+		cpu_relax();
+
+	result = p_msg->result;
+	smp_store_release(&p_msg->seq, ticket + DELEG_RING_SIZE);
+
+	return result;
+}
+
+/*
+ * Delegate of a NUMA node
+ *
+ * Polls the rings of every sender node and applies their requests in order.
+ * A ring with an unfilled message at its head is skipped until later.
+ */
+static int deleg_thread(void *arg)
+{
+	int home = (long)arg;
+	deleg_ring_t *p_ring;
+	deleg_msg_t *p_msg;
+	int i;
+
+	while (!kthread_should_stop()) {
+		for (i = 0; i < g_nr_deleg_nodes; i++) {
+			p_ring = g_rings[home][g_deleg_nodes[i]];
+			if (p_ring == NULL)
+				continue;
+
+			while (1) {
+				p_msg = &p_ring->msgs[p_ring->head %
+					DELEG_RING_SIZE];
+				if (smp_load_acquire(&p_msg->seq) !=
+						p_ring->head + 1)
+					break;
+
+				p_msg->result = deleg_apply(p_msg->val,
+						p_msg->op);
+				smp_store_release(&p_msg->seq,
+						p_ring->head + 2);
+				p_ring->head++;
+			}
+		}
+		cond_resched();
+	}
+
+	return 0;
+}
+
+/*
+ * Insert or delete a value
+ *
+ * Applied here if the bucket is homed on this node, or shipped to the
+ * delegate of the home node otherwise.
+ *
+ * Returns one if the bucket changed, zero if not.
+ */
+static int deleg_update(val_t val, int op)
+{
+	int home = deleg_home(HASH_VALUE(g_hash_list, val));
+	int node = numa_node_id();
+
+	if (home == node || g_rings[home][node] == NULL)
+		return deleg_apply(val, op);
+
+	return deleg_ship(g_rings[home][node], val, op);
+}
+
+static void deleg_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+static void deleg_stop(void)
+{
+	int i, j;
+
+	for (i = 0; i < NR_NUMA_NODES; i++) {
+		if (g_delegates[i])
+			kthread_stop(g_delegates[i]);
+		g_delegates[i] = NULL;
+		for (j = 0; j < NR_NUMA_NODES; j++) {
+			kfree(g_rings[i][j]);
+			g_rings[i][j] = NULL;
+		}
+	}
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global delegation hash list
+ *
+ * Starts one delegate per NUMA node with cpus, bound to the cpus of its node.
+ * A delegate takes cpu time from the benchmark threads of its node.
+ */
+int rcx_deleg_hash_list_init(int nr_buckets, void *dat)
+{
+	struct task_struct *t;
+	int home, node;
+	int i, j, k;
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	g_nr_deleg_nodes = 0;
+	for_each_node_with_cpus(node) {
+		if (node >= NR_NUMA_NODES)
+			break;
+		g_deleg_nodes[g_nr_deleg_nodes++] = node;
+	}
+
+	for (i = 0; i < g_nr_deleg_nodes; i++) {
+		home = g_deleg_nodes[i];
+		for (j = 0; j < g_nr_deleg_nodes; j++) {
+			node = g_deleg_nodes[j];
+			if (node == home)
+				continue;
+
+			g_rings[home][node] = kzalloc_node(sizeof(deleg_ring_t),
+					GFP_KERNEL, home);
+			if (g_rings[home][node] == NULL)
+				goto fail;
+			for (k = 0; k < DELEG_RING_SIZE; k++)
+				g_rings[home][node]->msgs[k].seq = k;
+		}
+
+		t = kthread_create_on_node(deleg_thread, (void *)(long)home,
+				home, "rcx_deleg/%d", home);
+		if (IS_ERR(t))
+			goto fail;
+		set_cpus_allowed_ptr(t, cpumask_of_node(home));
+		g_delegates[home] = t;
+		wake_up_process(t);
+	}
+
+	return 0;
+
+fail:
+	rcx_deleg_hash_list_destroy();
+	return -ENOMEM;
+}
+
+/*
+ * Destroy the global delegation hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_deleg_hash_list_destroy(void)
+{
+	int hash;
+
+	deleg_stop();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		deleg_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global delegation hash list
+ *
+ * Lookups are never shipped.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_deleg_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global delegation hash list
+ *
+ * Returns zero only
+ */
+int rcx_deleg_hash_list_add(void *tl, val_t val)
+{
+	deleg_update(val, RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global delegation hash list
+ *
+ * Returns zero only
+ */
+int rcx_deleg_hash_list_remove(void *tl, val_t val)
+{
+	deleg_update(val, RCX_OP_REMOVE);
+	return 0;
+}
@@ -0,0 +1,260 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+/* Elimination slots, chosen by the hash of the value */
+#define ELIM_BITS		(6)
+#define ELIM_SLOTS		(1 << ELIM_BITS)
+/* Polls of an offer before it is withdrawn */
+#define ELIM_SPINS		(256)
+
+/*
+ * An elimination slot holds one word: the value in the low 32 bits, then the
+ * operation and the state of the offer.  Only the updater that offered it
+ * empties a slot, so a word never comes back while its offer is waited on.
+ */
+#define ELIM_EMPTY		(0UL)
+#define ELIM_WAITING		(1UL)
+#define ELIM_DONE		(2UL)
+
+#define elim_word(val, op, state) \
+	((unsigned long)(u32)(val) | ((unsigned long)(op) << 32) | \
+	 ((unsigned long)(state) << 33))
+#define elim_val(word)		((val_t)(u32)(word))
+#define elim_op(word)		((int)(((word) >> 32) & 1UL))
+#define elim_state(word)	((word) >> 33)
+
+typedef struct elim_slot {
+	unsigned long word;
+} ____cacheline_aligned elim_slot_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static elim_slot_t g_elim_slots[ELIM_SLOTS];
+static DEFINE_PER_CPU(unsigned long, elim_count);
+
+/*
+ * Commit an update to a list without retrying on conflict
+ *
+ * Returns zero if committed or nothing to do, -EAGAIN on a conflict, or
+ * -ENOMEM.
+ */
+static int elim_try_commit(list_t *p_list, val_t val, int op)
+{
+	node_t *p_prev, *p_next, *p_new_node;
+	int ret = 0;
+
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_next->val < val) {
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	if (op == RCX_OP_ADD && p_next->val != val) {
+		p_new_node = rcx_new_node();
+		if (p_new_node == NULL) {
+			RCU_READER_UNLOCK();
+			return -ENOMEM;
+		}
+		p_new_node->val = val;
+		p_new_node->p_next = p_next;
+
+		ret = rcx_numa_link(p_prev, p_next, p_new_node);
+		if (ret)
+			kfree(p_new_node);
+	} else if (op == RCX_OP_REMOVE && p_next->val == val) {
+		ret = rcx_numa_unlink(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next));
+		if (!ret)
+			rcx_free_node(p_next);
+	}
+
+	RCU_READER_UNLOCK();
+	return ret;
+}
+
+/*
+ * Take an opposite offer of the same value in a slot
+ *
+ * Returns one if eliminated, zero else.
+ */
+static int elim_take(elim_slot_t *p_slot, val_t val, int op)
+{
+	unsigned long word = READ_ONCE(p_slot->word);
+
+	if (elim_state(word) != ELIM_WAITING || elim_val(word) != val ||
+			elim_op(word) == op)
+		return 0;
+
+	return cmpxchg(&p_slot->word, word,
+			elim_word(val, !op, ELIM_DONE)) == word;
+}
+
+/*
+ * Offer an update in a slot and wait for an opposite one for a while
+ *
+ * Returns one if eliminated, zero if the slot is busy or no one came.
+ */
+static int elim_offer(elim_slot_t *p_slot, val_t val, int op)
+{
+	unsigned long waiting = elim_word(val, op, ELIM_WAITING);
+	int i;
+
+	if (READ_ONCE(p_slot->word) != ELIM_EMPTY ||
+			cmpxchg(&p_slot->word, ELIM_EMPTY, waiting) !=
+			ELIM_EMPTY)
+		return 0;
+
+	for (i = 0; i < ELIM_SPINS; i++) {
+		if (READ_ONCE(p_slot->word) != waiting)
+			goto eliminated;
+		cpu_relax();
+	}
+
+	if (cmpxchg(&p_slot->word, waiting, ELIM_EMPTY) == waiting)
+		return 0;
+
+eliminated:
+	WRITE_ONCE(p_slot->word, ELIM_EMPTY);
+	return 1;
+}
+
+/*
+ * Insert or delete a value, or eliminate it against an opposite update
+ *
+ * An insert and a delete of the same value that meet in a slot both finish
+ * without touching the list.  They are linearized at the meeting, the delete
+ * first if the value is in the set and the insert first otherwise, so the set
+ * is left as it was and both succeed.  Offers are made only after a commit
+ * conflicted, so uncontended updates never wait.
+ */
+static void elim_update(val_t val, int op)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	elim_slot_t *p_slot = &g_elim_slots[hash_32(val, ELIM_BITS)];
+
+	while (1) {
+		if (elim_take(p_slot, val, op))
+			break;
+		if (elim_try_commit(g_hash_list->buckets[hash], val, op) == 0)
+			return;
+		if (elim_offer(p_slot, val, op))
+			break;
+	}
+
+	this_cpu_inc(elim_count);
+}
+
+static void elim_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global elimination hash list
+ */
+int rcx_elim_hash_list_init(int nr_buckets, void *dat)
+{
+	int cpu, i;
+
+	for (i = 0; i < ELIM_SLOTS; i++)
+		g_elim_slots[i].word = ELIM_EMPTY;
+	for_each_possible_cpu(cpu)
+		per_cpu(elim_count, cpu) = 0;
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Destroy the global elimination hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_elim_hash_list_destroy(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		elim_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global elimination hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_elim_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global elimination hash list
+ *
+ * Returns zero only
+ */
+int rcx_elim_hash_list_add(void *tl, val_t val)
+{
+	elim_update(val, RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global elimination hash list
+ *
+ * Returns zero only
+ */
+int rcx_elim_hash_list_remove(void *tl, val_t val)
+{
+	elim_update(val, RCX_OP_REMOVE);
+	return 0;
+}
+
+/*
+ * Get the number of updates eliminated so far
+ */
+unsigned long rcx_elim_hash_list_nr_eliminated(void)
+{
+	unsigned long nr = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		nr += per_cpu(elim_count, cpu);
+
+	return nr;
+}
@@ -0,0 +1,258 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/llist.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+/* Conflicts within FC_WINDOW that turn combining on for a bucket */
+#define FC_ON_CONFLICTS		(64)
+#define FC_WINDOW		(HZ / 100 + 1)
+/* Passes in a row that served only the combiner turn combining off */
+#define FC_OFF_PASSES		(1024)
+/* Most requests applied in one traversal */
+#define FC_MAX_BATCH		(64)
+
+/*
+ * Update request published by an updater
+ *
+ * Lives on the stack of the updater, which waits until a combiner sets done.
+ */
+typedef struct fc_request {
+	struct llist_node llnode;
+	rcx_update_t update;
+	int done;
+} fc_request_t;
+
+/*
+ * Flat combining state of a bucket
+ *
+ * Off by default, so updaters commit on their own with the RCX protocol.  When
+ * their conflicts cross FC_ON_CONFLICTS, updaters publish requests instead,
+ * and whoever takes the combiner lock applies all of them in one traversal.
+ * Combining turns off again after FC_OFF_PASSES passes without company.
+ */
+typedef struct fc_bucket {
+	struct llist_head pending;
+	/* A combiner allocates nodes, so it may sleep */
+	struct mutex combiner;
+	int enabled;
+	int nr_idle_passes;
+	atomic_t nr_conflicts;
+	unsigned long window;	/* jiffies the conflicts are counted from */
+} ____cacheline_aligned fc_bucket_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static fc_bucket_t *g_fc_buckets;
+
+/*
+ * Count conflicts of a bucket, and turn combining on if they are many
+ */
+static void fc_note_conflicts(fc_bucket_t *p_bucket, int nr)
+{
+	unsigned long now = jiffies;
+
+	if (time_after(now, READ_ONCE(p_bucket->window) + FC_WINDOW)) {
+		WRITE_ONCE(p_bucket->window, now);
+		atomic_set(&p_bucket->nr_conflicts, 0);
+	}
+
+	if (atomic_add_return(nr, &p_bucket->nr_conflicts) >= FC_ON_CONFLICTS) {
+		atomic_set(&p_bucket->nr_conflicts, 0);
+		WRITE_ONCE(p_bucket->enabled, 1);
+	}
+}
+
+/*
+ * Apply the pending requests of a bucket
+ *
+ * The requests are sorted by value, keeping the order of arrival for the same
+ * value, and applied with rcx_list_apply().  Caller should hold the combiner
+ * lock.
+ */
+static void fc_combine(list_t *p_list, fc_bucket_t *p_bucket)
+{
+	fc_request_t *reqs[FC_MAX_BATCH];
+	rcx_update_t updates[FC_MAX_BATCH];
+	struct llist_node *p_llnode;
+	fc_request_t *p_req;
+	int nr, i, j;
+
+	p_llnode = llist_reverse_order(llist_del_all(&p_bucket->pending));
+
+	while (p_llnode) {
+		for (nr = 0; p_llnode && nr < FC_MAX_BATCH; nr++) {
+			p_req = llist_entry(p_llnode, fc_request_t, llnode);
+			p_llnode = p_llnode->next;
+
+			/* Insertion sort, stable for the same value */
+			for (j = nr; j > 0 &&
+					reqs[j - 1]->update.val >
+					p_req->update.val; j--)
+				reqs[j] = reqs[j - 1];
+			reqs[j] = p_req;
+		}
+
+		for (i = 0; i < nr; i++)
+			updates[i] = reqs[i]->update;
+		rcx_list_apply(p_list, updates, nr);
+
+		/* A request may be gone as soon as it is done */
+		for (i = 0; i < nr; i++) {
+			reqs[i]->update.result = updates[i].result;
+			smp_store_release(&reqs[i]->done, 1);
+		}
+
+		if (nr > 1) {
+			p_bucket->nr_idle_passes = 0;
+		} else if (++p_bucket->nr_idle_passes >= FC_OFF_PASSES) {
+			p_bucket->nr_idle_passes = 0;
+			WRITE_ONCE(p_bucket->enabled, 0);
+		}
+	}
+}
+
+/*
+ * Insert or delete a value in a bucket
+ *
+ * Returns one if the bucket changed, zero if not.
+ */
+static int fc_update(list_t *p_list, fc_bucket_t *p_bucket, val_t val, int op)
+{
+	fc_request_t req;
+	int nr_retries;
+
+	req.update.val = val;
+	req.update.op = op;
+
+	if (!READ_ONCE(p_bucket->enabled)) {
+		nr_retries = rcx_list_apply(p_list, &req.update, 1);
+		if (nr_retries)
+			fc_note_conflicts(p_bucket, nr_retries);
+		return req.update.result;
+	}
+
+	req.done = 0;
+	llist_add(&req.llnode, &p_bucket->pending);
+
+	while (!smp_load_acquire(&req.done)) {
+		if (mutex_trylock(&p_bucket->combiner)) {
+			fc_combine(p_list, p_bucket);
+			mutex_unlock(&p_bucket->combiner);
+		} else {
+			cpu_relax();
+		}
+	}
+
+	return req.update.result;
+}
+
+static void fc_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global flat combining hash list
+ */
+int rcx_fc_hash_list_init(int nr_buckets, void *dat)
+{
+	int i;
+
+	g_fc_buckets = kmalloc(nr_buckets * sizeof(fc_bucket_t), GFP_KERNEL);
+	if (g_fc_buckets == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_buckets; i++) {
+		init_llist_head(&g_fc_buckets[i].pending);
+		mutex_init(&g_fc_buckets[i].combiner);
+		g_fc_buckets[i].enabled = 0;
+		g_fc_buckets[i].nr_idle_passes = 0;
+		atomic_set(&g_fc_buckets[i].nr_conflicts, 0);
+		g_fc_buckets[i].window = jiffies;
+	}
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL) {
+		kfree(g_fc_buckets);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Destroy the global flat combining hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_fc_hash_list_destroy(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		fc_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+	kfree(g_fc_buckets);
+}
+
+/*
+ * Check whether a value is in the global flat combining hash list
+ *
+ * Lookups never combine.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_fc_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global flat combining hash list
+ *
+ * Returns zero only
+ */
+int rcx_fc_hash_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	fc_update(g_hash_list->buckets[hash], &g_fc_buckets[hash], val,
+			RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global flat combining hash list
+ *
+ * Returns zero only
+ */
+int rcx_fc_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	fc_update(g_hash_list->buckets[hash], &g_fc_buckets[hash], val,
+			RCX_OP_REMOVE);
+	return 0;
+}
@@ -1,6 +1,9 @@
 #include <linux/slab.h>  // kmalloc
+#include <linux/mm.h>    // kvmalloc
 #include <linux/rcupdate.h>
 #include <linux/types.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
 
 
 #include "hash-list.h"
@@ -33,22 +36,36 @@ __cacheline_aligned static hash_list_t *g_hash_list;
 	(node->global_htmlock)
 
 /*
- * Allocate a node
+ * Initialize the flags and locks of a node
+ *
+ * Backends embedding node_t in their own node use this to put it under the
+ * RCX commit protocol.
  */
-node_t *rcx_new_node(void)
+void rcx_init_node(node_t *p_new_node)
 {
 	int nodeid;
-	node_t *p_new_node = kmalloc(sizeof(node_t), GFP_KERNEL);
-
-	if (p_new_node == NULL)
-		return NULL;
 
 	p_new_node->removed = 0;
+	p_new_node->version = 0;
+	p_new_node->data = 0;
 	p_new_node->pnode_locks[0] = 0;
 	for_each_node_with_cpus(nodeid)
 		pnodelockof(p_new_node, nodeid) = 0;
 	p_new_node->global_lock = __SPIN_LOCK_UNLOCKED(p_new_node->global_lock);
 	htmlock(p_new_node) = 0;
+}
+
+/*
+ * Allocate a node
+ */
+node_t *rcx_new_node(void)
+{
+	node_t *p_new_node = kmalloc(sizeof(node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	rcx_init_node(p_new_node);
 
 	return p_new_node;
 }
@@ -66,24 +83,43 @@ void rcx_free_node(node_t *p_node)
  * List
  **************************/
 
+static node_t *rcx_alloc_node(val_t val)
+{
+	node_t *p_new_node = rcx_new_node();
+
+	if (p_new_node)
+		p_new_node->val = val;
+	return p_new_node;
+}
+
 /*
  * Allocate and initialize a list
+ *
+ * The sentinels come from alloc, or are plain nodes if it is NULL.  A sentinel
+ * is freed with kfree() if the other can't be allocated.
  */
-list_t *rcx_new_list(void)
+list_t *rcx_new_list(rcx_alloc_t alloc)
 {
 	list_t *p_list;
 	node_t *p_min_node, *p_max_node;
 
+	if (alloc == NULL)
+		alloc = rcx_alloc_node;
+
 	p_list = kmalloc(sizeof(list_t), GFP_KERNEL);
 	if (p_list == NULL)
 		return NULL;
 
-	p_max_node = rcx_new_node();
-	p_max_node->val = LIST_VAL_MAX;
-	p_max_node->p_next = NULL;
+	p_max_node = alloc(LIST_VAL_MAX);
+	p_min_node = alloc(LIST_VAL_MIN);
+	if (p_max_node == NULL || p_min_node == NULL) {
+		kfree(p_max_node);
+		kfree(p_min_node);
+		kfree(p_list);
+		return NULL;
+	}
 
-	p_min_node = rcx_new_node();
-	p_min_node->val = LIST_VAL_MIN;
+	p_max_node->p_next = NULL;
 	p_min_node->p_next = p_max_node;
 
 	p_list->p_head = p_min_node;
@@ -123,19 +159,19 @@ static int list_size(list_t *p_list)
 }
 
 /*
- * Check whether give value is in the given list
+ * Check whether give value is in the given list without entering RCU read-side
+ * critical section
+ *
+ * Caller should be in RCU read-side critical section.
  *
  * Returns one if exists, zero else
  */
-int rcx_list_contains(list_t *p_list, val_t val)
+static int rcx_list_lookup(list_t *p_list, val_t val)
 {
-	int result;
 	val_t v;
 	node_t *p_prev, *p_next;
 	node_t *p_node;
 
-	RCU_READER_LOCK();
-
 	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
 	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	while (1) {
@@ -149,8 +185,20 @@ int rcx_list_contains(list_t *p_list, val_t val)
 		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	}
 
-	result = (v == val);
+	return (v == val);
+}
+
+/*
+ * Check whether give value is in the given list
+ *
+ * Returns one if exists, zero else
+ */
+int rcx_list_contains(list_t *p_list, val_t val)
+{
+	int result;
 
+	RCU_READER_LOCK();
+	result = rcx_list_lookup(p_list, val);
 	RCU_READER_UNLOCK();
 
 	return result;
@@ -617,356 +665,737 @@ unlock_retry:
 }
 
 /*
- * Insert a value into a list in NUMA-awared manner
+ * Take the locks of given nodes in NUMA-awared manner
  *
- * Returns one if the value is in the list already, or zero if insert done and
- * success.
+ * Per-NUMA node locks of all nodes are taken at once by a short HTM
+ * transaction, and then the global locks are taken in the given order, which
+ * should be the list order.
+ *
+ * Returns zero if locked, -EAGAIN if the transaction aborted.
  */
-int rcx_list_numa_add(list_t *p_list, val_t val)
+int rcx_numa_lock(node_t **nodes, int nr)
 {
-	int result;
-	node_t *p_prev, *p_next;
-	node_t *p_node;
-	val_t v;
 	int tx_stat;
+	int i;
 
-retry:
-	RCU_READER_LOCK();
-
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-
-	while (1) {
-		p_node = (node_t *)RCU_DEREF(p_next);
-		v = p_node->val;
+	for (i = 0; i < nr; i++)
+		while (pnodelock(nodes[i]) == 1)
+			;
 
-		if (v >= val)
-			break;
+	tx_stat = _xbegin();
+	if (tx_stat == _XBEGIN_STARTED) {
+		/* HTM CS.  It touches per-node locks only.  Slim enough, no
+		 * many contention */
+		for (i = 0; i < nr; i++)
+			if (pnodelock(nodes[i]) == 1)
+				_xabort(ABORT_CONFLICT);
 
-		p_prev = p_next;
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		for (i = 0; i < nr; i++)
+			pnodelock(nodes[i]) = 1;
+		_xend();
+	} else {
+		record_abort(tx_stat);
+		return -EAGAIN;
 	}
 
-	result = (v != val);
+	for (i = 0; i < nr; i++)
+		RCU_WRITER_LOCK(nodes[i]->global_lock);
 
-	if (result) {
-		node_t *p_new_node = rcx_new_node();
+	return 0;
+}
 
-		p_new_node->val = val;
-		p_new_node->p_next = p_next;
+/*
+ * Release the locks taken by rcx_numa_lock()
+ */
+void rcx_numa_unlock(node_t **nodes, int nr)
+{
+	int i;
 
-		while (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1)
-			;
+	for (i = nr - 1; i >= 0; i--)
+		RCU_WRITER_UNLOCK(nodes[i]->global_lock);
+	for (i = nr - 1; i >= 0; i--)
+		pnodelock(nodes[i]) = 0;
+}
 
-		tx_stat = _xbegin();
-		if (tx_stat == _XBEGIN_STARTED) {
-			/* HTM CS.  It touches per-node locks only.  Slim
-			 * enough, no many contention */
-			if (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1)
-				_xabort(ABORT_CONFLICT);
+/*
+ * Link a new node between two adjacent nodes in NUMA-awared manner
+ *
+ * This is the commit step of rcx_list_numa_add().  The link is validated under
+ * the locks of both nodes.
+ *
+ * Returns zero if linked, -EAGAIN if the transaction aborted or the nodes are
+ * not adjacent anymore.  Caller should retraverse the list in the latter case.
+ */
+int rcx_numa_link(node_t *p_prev, node_t *p_next, node_t *p_new_node)
+{
+	node_t *nodes[2] = {p_prev, p_next};
+	int ret = -EAGAIN;
+
+	if (rcx_numa_lock(nodes, 2))
+		return -EAGAIN;
+
+	/*
+	 * Spinlock CS.  Now there is no concurrent updaters, though previous
+	 * updaters could already touched something.
+	 */
+	if (RCU_DEREF(p_prev->p_next) != p_next) {
+		record_abort(ABORT_CONFLICT);
+		goto unlock;
+	}
+	if (p_prev->removed || p_next->removed) {
+		record_abort(ABORT_DOUBLE_FREE);
+		goto unlock;
+	}
+	p_prev->version += 2;
+	smp_wmb();
+	RCU_ASSIGN_PTR((p_prev->p_next), p_new_node);
+	ret = 0;
+
+unlock:
+	rcx_numa_unlock(nodes, 2);
+	return ret;
+}
 
-			pnodelock(p_prev) = 1;
-			pnodelock(p_next) = 1;
-			_xend();
-		} else {
-			RCU_READER_UNLOCK();
-			record_abort(tx_stat);
-			kfree(p_new_node);
-			goto retry;
-		}
+/*
+ * Unlink a node whose data is given from its neighbours in NUMA-awared manner
+ *
+ * Same with rcx_numa_unlink(), but the data is compared under the locks too if
+ * p_data is not NULL.
+ *
+ * Returns zero if unlinked, -ECANCELED if the data differs, or -EAGAIN.
+ */
+static int rcx_numa_unlink_if(node_t *p_prev, node_t *p_node, node_t *n,
+		const val_t *p_data)
+{
+	node_t *nodes[3] = {p_prev, p_node, n};
+	int ret = -EAGAIN;
 
-		RCU_WRITER_LOCK(p_prev->global_lock);
-		RCU_WRITER_LOCK(p_next->global_lock);
-		/*
-		 * Spinlock CS.  Now there is no concurrent updaters, though
-		 * previous updaters could already touched something.
-		 */
-		if (RCU_DEREF(p_prev->p_next) != p_next) {
-			RCU_READER_UNLOCK();
-			record_abort(ABORT_CONFLICT);
-			goto unlock_retry;
-		}
-		if (p_prev->removed || p_next->removed) {
-			RCU_READER_UNLOCK();
-			record_abort(ABORT_DOUBLE_FREE);
-			goto unlock_retry;
-		}
-		RCU_ASSIGN_PTR((p_prev->p_next), p_new_node);
-		RCU_WRITER_UNLOCK(p_next->global_lock);
-		RCU_WRITER_UNLOCK(p_prev->global_lock);
-		pnodelock(p_prev) = 0;
-		pnodelock(p_next) = 0;
-		RCU_READER_UNLOCK();
-		return result;
+	if (rcx_numa_lock(nodes, 3))
+		return -EAGAIN;
 
-unlock_retry:
-		RCU_WRITER_UNLOCK(p_next->global_lock);
-		RCU_WRITER_UNLOCK(p_prev->global_lock);
-		pnodelock(p_next) = 0;
-		pnodelock(p_prev) = 0;
-		RCU_READER_UNLOCK();
-		kfree(p_new_node);
-		goto retry;
+	/* Spinlock CS. */
+	if (p_prev->removed || p_node->removed || n->removed) {
+		record_abort(ABORT_DOUBLE_FREE);
+		goto unlock;
+	}
+	if (RCU_DEREF(p_prev->p_next) != p_node ||
+			RCU_DEREF(p_node->p_next) != n) {
+		record_abort(ABORT_CONFLICT);
+		goto unlock;
+	}
+	if (p_data && p_node->data != *p_data) {
+		ret = -ECANCELED;
+		goto unlock;
 	}
+	p_prev->version += 2;
+	p_node->version += 2;
+	smp_wmb();
+	RCU_ASSIGN_PTR((p_prev->p_next), n);
+	p_node->removed = 1;
+	ret = 0;
+
+unlock:
+	rcx_numa_unlock(nodes, 3);
+	return ret;
+}
 
-	return result;
+/*
+ * Unlink a node from its predecessor and successor in NUMA-awared manner
+ *
+ * This is the commit step of rcx_list_numa_remove().  The unlinked node is
+ * marked as removed, and caller is responsible for freeing it.
+ *
+ * Returns zero if unlinked, -EAGAIN if the transaction aborted or the nodes
+ * are not adjacent anymore.
+ */
+int rcx_numa_unlink(node_t *p_prev, node_t *p_node, node_t *n)
+{
+	return rcx_numa_unlink_if(p_prev, p_node, n, NULL);
 }
 
 /*
- * Deletes a value from a list
+ * Unlink a run of adjacent nodes at once in NUMA-awared manner
  *
- * Returns 2 if aborted, 1 if success, 0 if the list doesn't contain the value.
+ * Same with rcx_numa_unlink() for a run p_prev -> run[0] -> ... -> run[nr - 1]
+ * -> n, with one lock round and one assignment for the whole run.  At most
+ * RCX_RUN_MAX nodes can be given.  The unlinked nodes are marked as removed,
+ * and caller is responsible for freeing them.
+ *
+ * Returns zero if unlinked, -EINVAL if nr is out of range, or -EAGAIN if the
+ * transaction aborted or the nodes are not adjacent anymore.
  */
-int rcx_list_remove(list_t *p_list, val_t val)
+int rcx_numa_unlink_run(node_t *p_prev, node_t **run, int nr, node_t *n)
 {
-	int result;
-	node_t *p_prev, *p_next;
-	node_t *p_node;
-	node_t *n;
-	int tx_stat;
+	node_t *nodes[RCX_RUN_MAX + 2];
+	node_t *p_node = p_prev;
+	int ret = -EAGAIN;
+	int i;
 
-	RCU_READER_LOCK();
+	if (nr < 1 || nr > RCX_RUN_MAX)
+		return -EINVAL;
 
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-	while (1) {
-		p_node = (node_t *)RCU_DEREF(p_next);
+	nodes[0] = p_prev;
+	for (i = 0; i < nr; i++)
+		nodes[i + 1] = run[i];
+	nodes[nr + 1] = n;
 
-		if (p_node->val >= val)
-			break;
+	if (rcx_numa_lock(nodes, nr + 2))
+		return -EAGAIN;
 
-		p_prev = p_next;
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	/* Spinlock CS. */
+	for (i = 0; i < nr + 2; i++) {
+		if (nodes[i]->removed) {
+			record_abort(ABORT_DOUBLE_FREE);
+			goto unlock;
+		}
 	}
-
-	result = (p_node->val == val);
-
-	if (result) {
-		n = (node_t *)RCU_DEREF(p_next->p_next);
-		tx_stat = _xbegin();
-		if (tx_stat == _XBEGIN_STARTED) {
-			if (p_prev->removed || p_next->removed || n->removed)
-				_xabort(ABORT_DOUBLE_FREE);
-			if (RCU_DEREF(p_prev->p_next) != p_next ||
-					RCU_DEREF(p_next->p_next) != n)
-				_xabort(ABORT_CONFLICT);
-			RCU_ASSIGN_PTR((p_prev->p_next), n);
-			p_next->removed = 1;
-			_xend();
-		} else {
-			RCU_READER_UNLOCK();
-			record_abort(tx_stat);
-			return 2;
+	for (i = 1; i < nr + 2; i++) {
+		if (RCU_DEREF(p_node->p_next) != nodes[i]) {
+			record_abort(ABORT_CONFLICT);
+			goto unlock;
 		}
+		p_node = nodes[i];
+	}
+	for (i = 0; i < nr + 1; i++)
+		nodes[i]->version += 2;
+	smp_wmb();
+	RCU_ASSIGN_PTR((p_prev->p_next), n);
+	for (i = 0; i < nr; i++)
+		run[i]->removed = 1;
+	ret = 0;
+
+unlock:
+	rcx_numa_unlock(nodes, nr + 2);
+	return ret;
+}
 
-		RCU_READER_UNLOCK();
-		rcx_free_node(p_next);
+/*
+ * Replace the data of a node in NUMA-awared manner if it is as expected
+ *
+ * The node is validated to be still linked from its predecessor under the
+ * locks of both, the same as rcx_numa_link().
+ *
+ * Returns zero if replaced, -ECANCELED if the data differs, or -EAGAIN.
+ */
+static int rcx_numa_replace(node_t *p_prev, node_t *p_node, val_t old_data,
+		val_t new_data)
+{
+	node_t *nodes[2] = {p_prev, p_node};
+	int ret = -EAGAIN;
 
-		return result;
-	}
+	if (rcx_numa_lock(nodes, 2))
+		return -EAGAIN;
 
-	return result;
+	/* Spinlock CS. */
+	if (RCU_DEREF(p_prev->p_next) != p_node) {
+		record_abort(ABORT_CONFLICT);
+		goto unlock;
+	}
+	if (p_prev->removed || p_node->removed) {
+		record_abort(ABORT_DOUBLE_FREE);
+		goto unlock;
+	}
+	if (p_node->data != old_data) {
+		ret = -ECANCELED;
+		goto unlock;
+	}
+	p_node->version += 2;
+	smp_wmb();
+	WRITE_ONCE(p_node->data, new_data);
+	ret = 0;
+
+unlock:
+	rcx_numa_unlock(nodes, 2);
+	return ret;
 }
 
 /*
- * Deletes a value from a list with locking fallback
+ * Freeze all nodes of a list
  *
- * Returns 1 if success, 0 if the list doesn't contain the value.
+ * Marks every node, including the sentinels, as removed under its global lock.
+ * RCX updaters then fail their validation and retraverse from p_list->p_head,
+ * and the p_next of a frozen node never changes.  Readers are not affected.
+ * Caller should serialize the freezes of the list and publish a new p_head.
  */
-int rcx_list_lf_remove(list_t *p_list, val_t val)
+void rcx_list_freeze(list_t *p_list)
 {
-	int result;
-	node_t *p_prev, *p_next;
 	node_t *p_node;
-	node_t *n;
-	int tx_stat;
-	int retries = 0;
 
-retry:
-	RCU_READER_LOCK();
+	for (p_node = (node_t *)RCU_DEREF(p_list->p_head);
+			p_node != NULL;
+			p_node = (node_t *)RCU_DEREF(p_node->p_next)) {
+		RCU_WRITER_LOCK(p_node->global_lock);
+		p_node->version += 2;
+		smp_wmb();
+		p_node->removed = 1;
+		RCU_WRITER_UNLOCK(p_node->global_lock);
+	}
+}
 
-	if (retries++ >= LF_RETRY_LIMIT) {
-		retries = 0;
-		RCU_WRITER_LOCK(p_list->rcuspin);
+static void rcx_free_chain_rcu(struct rcu_head *rcu)
+{
+	node_t *iter, *next;
 
-		p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-		while (1) {
-			p_node = (node_t *)RCU_DEREF(p_next);
+	for (iter = container_of(rcu, node_t, rcu); iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
 
-			if (p_node->val >= val)
-				break;
+/*
+ * Free a frozen chain of nodes after one grace period
+ *
+ * The chain should be unreachable from p_list->p_head already.
+ */
+void rcx_free_chain(node_t *p_head)
+{
+	call_rcu(&p_head->rcu, rcx_free_chain_rcu);
+}
 
-			p_prev = p_next;
-			p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-		}
+/* Serializes the rebuilds of all lists.  Bulk writers are rare. */
+static DEFINE_MUTEX(rcx_rebuild_lock);
 
-		result = (p_node->val == val);
-		if (result) {
-			n = (node_t *)RCU_DEREF(p_next->p_next);
-			RCU_ASSIGN_PTR((p_prev->p_next), n);
-			n->removed = 1;
-			RCU_WRITER_UNLOCK(p_list->rcuspin);
-			RCU_READER_UNLOCK();
-			rcx_free_node(p_next);
+static node_t *rcx_rebuild_append(node_t *p_tail, val_t val, val_t data)
+{
+	node_t *p_new_node = kmalloc(sizeof(node_t), GFP_KERNEL | __GFP_NOFAIL);
 
-			return 1;
-		}
+	rcx_init_node(p_new_node);
+	p_new_node->val = val;
+	p_new_node->data = data;
+	p_new_node->p_next = NULL;
+	if (p_tail)
+		p_tail->p_next = p_new_node;
 
-		RCU_WRITER_UNLOCK(p_list->rcuspin);
-		RCU_READER_UNLOCK();
-		return 0;
-	}
+	return p_new_node;
+}
 
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-	while (1) {
-		p_node = (node_t *)RCU_DEREF(p_next);
+/*
+ * Apply a batch of updates sorted by value by rebuilding a list
+ *
+ * The list is frozen, which takes the global lock of each node once, and a new
+ * sorted chain merging the list and the batch is built off to the side.  It is
+ * published with one assignment to p_list->p_head, and the old chain is freed
+ * after one grace period.  Readers never wait.  RCX updaters in flight fail
+ * their validation on the frozen nodes and retry on the new chain.
+ *
+ * This is O(list + batch), so it pays off when the batch rewrites a large
+ * share of the list.  Updates of the same value are applied in their order in
+ * the batch, and a value kept in the list keeps its data.  The result of each
+ * update is one if it changed the list, zero else.
+ *
+ * Returns the number of updates that changed the list.
+ */
+int rcx_list_rebuild(list_t *p_list, rcx_update_t *updates, int nr)
+{
+	node_t *p_head, *p_old, *p_new_head, *p_tail;
+	int nr_changed = 0;
+	int present, i = 0;
+	val_t v, data;
+
+	mutex_lock(&rcx_rebuild_lock);
+
+	rcx_list_freeze(p_list);
+	p_head = (node_t *)RCU_DEREF(p_list->p_head);
+
+	p_new_head = rcx_rebuild_append(NULL, LIST_VAL_MIN, 0);
+	p_tail = p_new_head;
+
+	/* The max sentinel is the only node with a NULL p_next */
+	p_old = p_head->p_next;
+	while (p_old->p_next || i < nr) {
+		if (i == nr || (p_old->p_next && p_old->val < updates[i].val)) {
+			p_tail = rcx_rebuild_append(p_tail, p_old->val,
+					p_old->data);
+			p_old = p_old->p_next;
+			continue;
+		}
 
-		if (p_node->val >= val)
-			break;
+		v = updates[i].val;
+		present = (p_old->p_next && p_old->val == v);
+		data = 0;
+		if (present) {
+			data = p_old->data;
+			p_old = p_old->p_next;
+		}
 
-		p_prev = p_next;
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		for (; i < nr && updates[i].val == v; i++) {
+			if (updates[i].op == RCX_OP_ADD) {
+				updates[i].result = !present;
+				present = 1;
+			} else {
+				updates[i].result = present;
+				present = 0;
+				data = 0;
+			}
+			nr_changed += updates[i].result;
+		}
+
+		if (present)
+			p_tail = rcx_rebuild_append(p_tail, v, data);
 	}
+	rcx_rebuild_append(p_tail, LIST_VAL_MAX, 0);
 
-	result = (p_node->val == val);
+	RCU_ASSIGN_PTR(p_list->p_head, p_new_head);
+	rcx_free_chain(p_head);
 
-	if (result) {
-		while (spin_is_locked(&p_list->rcuspin))
-			;
-		n = (node_t *)RCU_DEREF(p_next->p_next);
-		tx_stat = _xbegin();
-		if (tx_stat == _XBEGIN_STARTED) {
-			if (spin_is_locked(&p_list->rcuspin))
-				_xabort(ABORT_LF_CONFLICT);
-			if (p_prev->removed || p_next->removed || n->removed)
-				_xabort(ABORT_DOUBLE_FREE);
-			if (RCU_DEREF(p_prev->p_next) != p_next ||
-					RCU_DEREF(p_next->p_next) != n)
-				_xabort(ABORT_CONFLICT);
-			RCU_ASSIGN_PTR((p_prev->p_next), n);
-			p_next->removed = 1;
-			_xend();
-		} else {
-			RCU_READER_UNLOCK();
-			record_abort(tx_stat);
-			goto retry;
-		}
+	mutex_unlock(&rcx_rebuild_lock);
+	return nr_changed;
+}
 
-		RCU_READER_UNLOCK();
-		rcx_free_node(p_next);
+/*
+ * Get the node to start a search for a value from
+ *
+ * The finger is used if it is still in the list and smaller than the value.
+ * Otherwise, the search starts from the head.
+ */
+static node_t *rcx_list_start(list_t *p_list, node_t *p_finger, val_t val)
+{
+	if (p_finger && p_finger->val < val && !p_finger->removed)
+		return p_finger;
+	return (node_t *)RCU_DEREF(p_list->p_head);
+}
 
-		return result;
+/*
+ * Check whether give value is in the given list, starting from a finger
+ *
+ * The finger is updated to the last node smaller than the value.  Caller
+ * should be in a read-side session, and the finger is valid only within the
+ * session it was obtained in.  *pp_finger could be NULL.
+ *
+ * Returns one if exists, zero else
+ */
+int rcx_list_finger_contains(list_t *p_list, val_t val, node_t **pp_finger)
+{
+	val_t v;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+
+	p_prev = rcx_list_start(p_list, *pp_finger, val);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+		v = p_node->val;
+
+		if (v >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	}
 
-	RCU_READER_UNLOCK();
-	return result;
+	*pp_finger = p_prev;
+	return (v == val);
 }
 
 /*
- * Deletes a value from a list with locking fallback, retry based on abort
- * reason
+ * Insert a value into a list in NUMA-awared manner, starting from a finger
  *
- * Returns 1 if success, 0 if the list doesn't contain the value.
+ * Same with rcx_list_numa_add(), but the traversal starts from *pp_finger if it
+ * is usable, and *pp_finger is updated to the predecessor of the value.
+ * pp_finger could be NULL.
+ *
+ * Returns one if the value is in the list already, or zero if insert done and
+ * success.
  */
-int rcx_list_fb1_remove(list_t *p_list, val_t val)
+int rcx_list_finger_add(list_t *p_list, val_t val, node_t **pp_finger)
 {
 	int result;
 	node_t *p_prev, *p_next;
 	node_t *p_node;
-	node_t *n;
-	int tx_stat;
+	val_t v;
 
-htm_path:
+retry:
 	RCU_READER_LOCK();
 
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_prev = rcx_list_start(p_list, pp_finger ? *pp_finger : NULL, val);
 	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+
 	while (1) {
 		p_node = (node_t *)RCU_DEREF(p_next);
+		v = p_node->val;
 
-		if (p_node->val >= val)
+		if (v >= val)
 			break;
 
 		p_prev = p_next;
 		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 	}
 
-	result = (p_node->val == val);
+	result = (v != val);
 
 	if (result) {
-		while (spin_is_locked(&p_list->rcuspin))
-			;
-		n = (node_t *)RCU_DEREF(p_next->p_next);
-		tx_stat = _xbegin();
-		if (tx_stat == _XBEGIN_STARTED) {
-			if (spin_is_locked(&p_list->rcuspin))
-				_xabort(ABORT_LF_CONFLICT);
-			if (p_prev->removed || p_next->removed || n->removed)
-				_xabort(ABORT_DOUBLE_FREE);
-			if (RCU_DEREF(p_prev->p_next) != p_next ||
-					RCU_DEREF(p_next->p_next) != n)
-				_xabort(ABORT_CONFLICT);
-			RCU_ASSIGN_PTR((p_prev->p_next), n);
-			p_next->removed = 1;
-			_xend();
-		} else {
+		node_t *p_new_node = rcx_new_node();
+
+		p_new_node->val = val;
+		p_new_node->p_next = p_next;
+
+		if (rcx_numa_link(p_prev, p_next, p_new_node)) {
 			RCU_READER_UNLOCK();
-			record_abort(tx_stat);
-			if (tx_stat & _XABORT_RETRY)
-				goto htm_path;
-			else
-				goto locking_path;
+			kfree(p_new_node);
+			goto retry;
 		}
+	}
 
-		rcx_free_node(p_next);
+	if (pp_finger)
+		*pp_finger = p_prev;
+	RCU_READER_UNLOCK();
+	return result;
+}
 
-		RCU_READER_UNLOCK();
-		return result;
+/*
+ * Apply a batch of updates sorted by value in one traversal
+ *
+ * Each update commits in the same way with rcx_list_numa_add() or
+ * rcx_list_numa_remove(), and the traversal resumes from the predecessor of
+ * the previous value.  Updates of the same value are applied in their order in
+ * the batch.  The result of each update is one if it changed the list, zero
+ * else.
+ *
+ * Returns the number of commits retried on conflicts.
+ */
+int rcx_list_apply(list_t *p_list, rcx_update_t *updates, int nr)
+{
+	node_t *p_prev = NULL;
+	node_t *p_next;
+	rcx_update_t *p_update;
+	int nr_retries = 0;
+	int i;
+
+	RCU_READER_LOCK();
+
+	for (i = 0; i < nr; i++) {
+		p_update = &updates[i];
+retry:
+		p_prev = rcx_list_start(p_list, p_prev, p_update->val);
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		while (p_next->val < p_update->val) {
+			p_prev = p_next;
+			p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		}
+
+		if (p_update->op == RCX_OP_ADD) {
+			node_t *p_new_node;
+
+			p_update->result = (p_next->val != p_update->val);
+			if (!p_update->result)
+				continue;
+
+			p_new_node = rcx_new_node();
+			p_new_node->val = p_update->val;
+			p_new_node->p_next = p_next;
+
+			if (rcx_numa_link(p_prev, p_next, p_new_node)) {
+				kfree(p_new_node);
+				nr_retries++;
+				goto retry;
+			}
+		} else {
+			p_update->result = (p_next->val == p_update->val);
+			if (!p_update->result)
+				continue;
+
+			if (rcx_numa_unlink(p_prev, p_next,
+					(node_t *)RCU_DEREF(p_next->p_next))) {
+				nr_retries++;
+				goto retry;
+			}
+			rcx_free_node(p_next);
+		}
 	}
 
 	RCU_READER_UNLOCK();
-	return result;
+	return nr_retries;
+}
 
-locking_path:
-	RCU_WRITER_LOCK(p_list->rcuspin);
+#define MANY_HTM_RETRY_LIMIT	10
 
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-	while (1) {
-		p_node = (node_t *)RCU_DEREF(p_next);
+/*
+ * Commit updates of one kind on sorted distinct values in one transaction
+ *
+ * A single traversal finds the neighbours of every value, and then a single
+ * HTM region validates all of them and links or unlinks every node at once.
+ * No lock is taken.  The global locks of the neighbours are only checked, so
+ * an RCX commit holding one aborts the transaction, and one taking it later
+ * fails its own validation.  The result of each update is one if it changed
+ * the list, zero else.
+ *
+ * Returns _XBEGIN_STARTED if committed, or the abort status.
+ */
+static unsigned int rcx_list_commit_many(list_t *p_list, rcx_update_t *updates,
+		int nr, int op)
+{
+	node_t *prevs[MAX_BATCH], *currs[MAX_BATCH], *new_nodes[MAX_BATCH];
+	node_t *p_prev, *p_curr, *n;
+	unsigned int tx_stat;
+	int i;
 
-		if (p_node->val >= val)
-			break;
+	RCU_READER_LOCK();
 
-		p_prev = p_next;
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	for (i = 0; i < nr; i++) {
+		p_curr = (node_t *)RCU_DEREF(p_prev->p_next);
+		while (p_curr->val < updates[i].val) {
+			p_prev = p_curr;
+			p_curr = (node_t *)RCU_DEREF(p_prev->p_next);
+		}
+		prevs[i] = p_prev;
+		currs[i] = p_curr;
+
+		if (op == RCX_OP_ADD)
+			updates[i].result = (p_curr->val != updates[i].val);
+		else
+			updates[i].result = (p_curr->val == updates[i].val);
+
+		new_nodes[i] = NULL;
+		if (op == RCX_OP_ADD && updates[i].result) {
+			new_nodes[i] = rcx_new_node();
+			if (new_nodes[i] == NULL) {
+				tx_stat = _XABORT_CAPACITY;
+				goto free;
+			}
+			new_nodes[i]->val = updates[i].val;
+			new_nodes[i]->p_next = p_curr;
+		}
 	}
 
-	result = (p_node->val == val);
-	if (result) {
-		n = (node_t *)RCU_DEREF(p_next->p_next);
-		RCU_ASSIGN_PTR((p_prev->p_next), n);
-		n->removed = 1;
-		RCU_WRITER_UNLOCK(p_list->rcuspin);
-		RCU_READER_UNLOCK();
-		rcx_free_node(p_next);
+	tx_stat = _xbegin();
+	if (tx_stat == _XBEGIN_STARTED) {
+		for (i = 0; i < nr; i++) {
+			if (spin_is_locked(&prevs[i]->global_lock) ||
+					spin_is_locked(&currs[i]->global_lock))
+				_xabort(ABORT_CONFLICT);
+			if (RCU_DEREF(prevs[i]->p_next) != currs[i])
+				_xabort(ABORT_CONFLICT);
+			if (prevs[i]->removed || currs[i]->removed)
+				_xabort(ABORT_DOUBLE_FREE);
+		}
 
-		return 1;
+		for (i = 0; i < nr; i++) {
+			if (!updates[i].result)
+				continue;
+
+			/*
+			 * A node linked or unlinked just before in this
+			 * transaction may stand for the predecessor.
+			 */
+			p_prev = prevs[i];
+			if (op == RCX_OP_ADD) {
+				if (i > 0 && prevs[i - 1] == p_prev &&
+						updates[i - 1].result)
+					p_prev = new_nodes[i - 1];
+				p_prev->version += 2;
+				RCU_ASSIGN_PTR((p_prev->p_next), new_nodes[i]);
+			} else {
+				if (i > 0 && currs[i - 1] == p_prev &&
+						updates[i - 1].result)
+					p_prev = prevs[i - 1];
+				prevs[i] = p_prev;
+
+				n = (node_t *)RCU_DEREF(currs[i]->p_next);
+				if (spin_is_locked(&n->global_lock) ||
+						n->removed)
+					_xabort(ABORT_CONFLICT);
+				p_prev->version += 2;
+				currs[i]->version += 2;
+				RCU_ASSIGN_PTR((p_prev->p_next), n);
+				currs[i]->removed = 1;
+			}
+		}
+		_xend();
+	} else {
+		record_abort(tx_stat);
+		goto free;
 	}
 
-	RCU_WRITER_UNLOCK(p_list->rcuspin);
 	RCU_READER_UNLOCK();
-	return 0;
+
+	if (op == RCX_OP_REMOVE)
+		for (i = 0; i < nr; i++)
+			if (updates[i].result)
+				rcx_free_node(currs[i]);
+	return tx_stat;
+
+free:
+	RCU_READER_UNLOCK();
+	for (i = 0; i < nr; i++)
+		kfree(new_nodes[i]);
+	return tx_stat;
 }
 
 /*
- * Deletes a value from a list in NUMA-awared manner, using HTM lock
+ * Apply updates of one kind on sorted distinct values
  *
- * Returns 1 if success, 0 if the list doesn't contain the value.
+ * Tries rcx_list_commit_many() first, and falls back to committing each value
+ * on its own with rcx_list_apply() on a capacity abort or too many conflicts.
+ *
+ * Returns the number of values that changed the list.
  */
-int rcx_list_htmlock_remove(list_t *p_list, val_t val)
+static int rcx_list_many(list_t *p_list, val_t *vals, int nr, int op)
+{
+	rcx_update_t updates[MAX_BATCH];
+	unsigned int tx_stat;
+	int nr_changed = 0;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		updates[i].val = vals[i];
+		updates[i].op = op;
+	}
+
+	for (i = 0; i < MANY_HTM_RETRY_LIMIT; i++) {
+		tx_stat = rcx_list_commit_many(p_list, updates, nr, op);
+		if (tx_stat == _XBEGIN_STARTED || tx_stat & _XABORT_CAPACITY)
+			break;
+	}
+	if (tx_stat != _XBEGIN_STARTED)
+		rcx_list_apply(p_list, updates, nr);
+
+	for (i = 0; i < nr; i++)
+		nr_changed += updates[i].result;
+	return nr_changed;
+}
+
+/*
+ * Insert sorted distinct values into a list at once
+ *
+ * At most MAX_BATCH values can be given.
+ *
+ * Returns the number of values inserted.
+ */
+int rcx_list_numa_add_many(list_t *p_list, val_t *vals, int nr)
+{
+	return rcx_list_many(p_list, vals, nr, RCX_OP_ADD);
+}
+
+/*
+ * Delete sorted distinct values from a list at once
+ *
+ * At most MAX_BATCH values can be given.
+ *
+ * Returns the number of values deleted.
+ */
+int rcx_list_numa_remove_many(list_t *p_list, val_t *vals, int nr)
+{
+	return rcx_list_many(p_list, vals, nr, RCX_OP_REMOVE);
+}
+
+/*
+ * Insert a value into a list in NUMA-awared manner
+ *
+ * Returns one if the value is in the list already, or zero if insert done and
+ * success.
+ */
+int rcx_list_numa_add(list_t *p_list, val_t val)
+{
+	return rcx_list_finger_add(p_list, val, NULL);
+}
+
+/*
+ * Deletes a value from a list
+ *
+ * Returns 2 if aborted, 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_remove(list_t *p_list, val_t val)
 {
 	int result;
 	node_t *p_prev, *p_next;
@@ -974,7 +1403,6 @@ int rcx_list_htmlock_remove(list_t *p_list, val_t val)
 	node_t *n;
 	int tx_stat;
 
-retry:
 	RCU_READER_LOCK();
 
 	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
@@ -993,57 +1421,121 @@ retry:
 
 	if (result) {
 		n = (node_t *)RCU_DEREF(p_next->p_next);
-		/* p_prev -> p_next -> n */
-
-		while (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
-				htmlock(n) == 1)
-			smp_wmb();
-
 		tx_stat = _xbegin();
 		if (tx_stat == _XBEGIN_STARTED) {
-			if (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
-					htmlock(n) == 1)
+			if (p_prev->removed || p_next->removed || n->removed)
+				_xabort(ABORT_DOUBLE_FREE);
+			if (RCU_DEREF(p_prev->p_next) != p_next ||
+					RCU_DEREF(p_next->p_next) != n)
 				_xabort(ABORT_CONFLICT);
-
-			htmlock(p_prev) = 1;
-			htmlock(p_next) = 1;
-			htmlock(n) = 1;
+			RCU_ASSIGN_PTR((p_prev->p_next), n);
+			p_next->removed = 1;
 			_xend();
 		} else {
 			RCU_READER_UNLOCK();
 			record_abort(tx_stat);
-			goto retry;
+			return 2;
 		}
 
-		/* Complete CS. */
-		if (p_prev->removed || p_next->removed || n->removed) {
-			record_abort(ABORT_DOUBLE_FREE);
-			RCU_READER_UNLOCK();
-			goto unlock_retry;
+		RCU_READER_UNLOCK();
+		rcx_free_node(p_next);
+
+		return result;
+	}
+
+	return result;
+}
+
+/*
+ * Deletes a value from a list with locking fallback
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_lf_remove(list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	node_t *n;
+	int tx_stat;
+	int retries = 0;
+
+retry:
+	RCU_READER_LOCK();
+
+	if (retries++ >= LF_RETRY_LIMIT) {
+		retries = 0;
+		RCU_WRITER_LOCK(p_list->rcuspin);
+
+		p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		while (1) {
+			p_node = (node_t *)RCU_DEREF(p_next);
+
+			if (p_node->val >= val)
+				break;
+
+			p_prev = p_next;
+			p_next = (node_t *)RCU_DEREF(p_prev->p_next);
 		}
-		if (RCU_DEREF(p_prev->p_next) != p_next ||
-				RCU_DEREF(p_next->p_next) != n) {
-			record_abort(ABORT_CONFLICT);
+
+		result = (p_node->val == val);
+		if (result) {
+			n = (node_t *)RCU_DEREF(p_next->p_next);
+			RCU_ASSIGN_PTR((p_prev->p_next), n);
+			n->removed = 1;
+			RCU_WRITER_UNLOCK(p_list->rcuspin);
 			RCU_READER_UNLOCK();
-			goto unlock_retry;
-		}
+			rcx_free_node(p_next);
 
-		RCU_ASSIGN_PTR((p_prev->p_next), n);
-		p_next->removed = 1;
-		rcx_free_node(p_next);
+			return 1;
+		}
 
-		htmlock(n) = 0;
-		htmlock(p_next) = 0;
-		htmlock(p_prev) = 0;
+		RCU_WRITER_UNLOCK(p_list->rcuspin);
 		RCU_READER_UNLOCK();
-		return result;
+		return 0;
+	}
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+
+	if (result) {
+		while (spin_is_locked(&p_list->rcuspin))
+			;
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(&p_list->rcuspin))
+				_xabort(ABORT_LF_CONFLICT);
+			if (p_prev->removed || p_next->removed || n->removed)
+				_xabort(ABORT_DOUBLE_FREE);
+			if (RCU_DEREF(p_prev->p_next) != p_next ||
+					RCU_DEREF(p_next->p_next) != n)
+				_xabort(ABORT_CONFLICT);
+			RCU_ASSIGN_PTR((p_prev->p_next), n);
+			p_next->removed = 1;
+			_xend();
+		} else {
+			RCU_READER_UNLOCK();
+			record_abort(tx_stat);
+			goto retry;
+		}
 
-unlock_retry:
-		htmlock(n) = 0;
-		htmlock(p_next) = 0;
-		htmlock(p_prev) = 0;
 		RCU_READER_UNLOCK();
-		goto retry;
+		rcx_free_node(p_next);
+
+		return result;
 	}
 
 	RCU_READER_UNLOCK();
@@ -1051,11 +1543,12 @@ unlock_retry:
 }
 
 /*
- * Deletes a value from a list in NUMA-awared manner, using HTM
+ * Deletes a value from a list with locking fallback, retry based on abort
+ * reason
  *
  * Returns 1 if success, 0 if the list doesn't contain the value.
  */
-int rcx_list_hhtmlock_remove(list_t *p_list, val_t val)
+int rcx_list_fb1_remove(list_t *p_list, val_t val)
 {
 	int result;
 	node_t *p_prev, *p_next;
@@ -1063,7 +1556,7 @@ int rcx_list_hhtmlock_remove(list_t *p_list, val_t val)
 	node_t *n;
 	int tx_stat;
 
-retry:
+htm_path:
 	RCU_READER_LOCK();
 
 	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
@@ -1081,30 +1574,105 @@ retry:
 	result = (p_node->val == val);
 
 	if (result) {
+		while (spin_is_locked(&p_list->rcuspin))
+			;
 		n = (node_t *)RCU_DEREF(p_next->p_next);
-		/* p_prev -> p_next -> n */
-
-		while (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
-				pnodelock(n) == 1)
-			smp_wmb();
-
 		tx_stat = _xbegin();
 		if (tx_stat == _XBEGIN_STARTED) {
-			if (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
-					pnodelock(n) == 1)
+			if (spin_is_locked(&p_list->rcuspin))
+				_xabort(ABORT_LF_CONFLICT);
+			if (p_prev->removed || p_next->removed || n->removed)
+				_xabort(ABORT_DOUBLE_FREE);
+			if (RCU_DEREF(p_prev->p_next) != p_next ||
+					RCU_DEREF(p_next->p_next) != n)
 				_xabort(ABORT_CONFLICT);
-
-			pnodelock(p_prev) = 1;
-			pnodelock(p_next) = 1;
-			pnodelock(n) = 1;
+			RCU_ASSIGN_PTR((p_prev->p_next), n);
+			p_next->removed = 1;
 			_xend();
 		} else {
 			RCU_READER_UNLOCK();
 			record_abort(tx_stat);
-			goto retry;
+			if (tx_stat & _XABORT_RETRY)
+				goto htm_path;
+			else
+				goto locking_path;
 		}
 
-retry_global_lock:
+		rcx_free_node(p_next);
+
+		RCU_READER_UNLOCK();
+		return result;
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+
+locking_path:
+	RCU_WRITER_LOCK(p_list->rcuspin);
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		RCU_ASSIGN_PTR((p_prev->p_next), n);
+		n->removed = 1;
+		RCU_WRITER_UNLOCK(p_list->rcuspin);
+		RCU_READER_UNLOCK();
+		rcx_free_node(p_next);
+
+		return 1;
+	}
+
+	RCU_WRITER_UNLOCK(p_list->rcuspin);
+	RCU_READER_UNLOCK();
+	return 0;
+}
+
+/*
+ * Deletes a value from a list in NUMA-awared manner, using HTM lock
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_htmlock_remove(list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	node_t *n;
+	int tx_stat;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		/* p_prev -> p_next -> n */
+
 		while (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
 				htmlock(n) == 1)
 			smp_wmb();
@@ -1114,6 +1682,7 @@ retry_global_lock:
 			if (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
 					htmlock(n) == 1)
 				_xabort(ABORT_CONFLICT);
+
 			htmlock(p_prev) = 1;
 			htmlock(p_next) = 1;
 			htmlock(n) = 1;
@@ -1121,235 +1690,1239 @@ retry_global_lock:
 		} else {
 			RCU_READER_UNLOCK();
 			record_abort(tx_stat);
-			goto retry_global_lock;
+			goto retry;
 		}
 
 		/* Complete CS. */
 		if (p_prev->removed || p_next->removed || n->removed) {
-			RCU_READER_UNLOCK();
 			record_abort(ABORT_DOUBLE_FREE);
+			RCU_READER_UNLOCK();
 			goto unlock_retry;
 		}
-		if (RCU_DEREF(p_prev->p_next) != p_next ||
-				RCU_DEREF(p_next->p_next) != n) {
-			RCU_READER_UNLOCK();
-			record_abort(ABORT_CONFLICT);
-			goto unlock_retry;
+		if (RCU_DEREF(p_prev->p_next) != p_next ||
+				RCU_DEREF(p_next->p_next) != n) {
+			record_abort(ABORT_CONFLICT);
+			RCU_READER_UNLOCK();
+			goto unlock_retry;
+		}
+
+		RCU_ASSIGN_PTR((p_prev->p_next), n);
+		p_next->removed = 1;
+		rcx_free_node(p_next);
+
+		htmlock(n) = 0;
+		htmlock(p_next) = 0;
+		htmlock(p_prev) = 0;
+		RCU_READER_UNLOCK();
+		return result;
+
+unlock_retry:
+		htmlock(n) = 0;
+		htmlock(p_next) = 0;
+		htmlock(p_prev) = 0;
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Deletes a value from a list in NUMA-awared manner, using HTM
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_hhtmlock_remove(list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	node_t *n;
+	int tx_stat;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		/* p_prev -> p_next -> n */
+
+		while (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
+				pnodelock(n) == 1)
+			smp_wmb();
+
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
+					pnodelock(n) == 1)
+				_xabort(ABORT_CONFLICT);
+
+			pnodelock(p_prev) = 1;
+			pnodelock(p_next) = 1;
+			pnodelock(n) = 1;
+			_xend();
+		} else {
+			RCU_READER_UNLOCK();
+			record_abort(tx_stat);
+			goto retry;
+		}
+
+retry_global_lock:
+		while (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
+				htmlock(n) == 1)
+			smp_wmb();
+
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (htmlock(p_prev) == 1 || htmlock(p_next) == 1 ||
+					htmlock(n) == 1)
+				_xabort(ABORT_CONFLICT);
+			htmlock(p_prev) = 1;
+			htmlock(p_next) = 1;
+			htmlock(n) = 1;
+			_xend();
+		} else {
+			RCU_READER_UNLOCK();
+			record_abort(tx_stat);
+			goto retry_global_lock;
+		}
+
+		/* Complete CS. */
+		if (p_prev->removed || p_next->removed || n->removed) {
+			RCU_READER_UNLOCK();
+			record_abort(ABORT_DOUBLE_FREE);
+			goto unlock_retry;
+		}
+		if (RCU_DEREF(p_prev->p_next) != p_next ||
+				RCU_DEREF(p_next->p_next) != n) {
+			RCU_READER_UNLOCK();
+			record_abort(ABORT_CONFLICT);
+			goto unlock_retry;
+		}
+
+		RCU_ASSIGN_PTR((p_prev->p_next), n);
+		p_next->removed = 1;
+		rcx_free_node(p_next);
+
+		htmlock(n) = 0;
+		htmlock(p_next) = 0;
+		htmlock(p_prev) = 0;
+		pnodelock(n) = 0;
+		pnodelock(p_next) = 0;
+		pnodelock(p_prev) = 0;
+
+		RCU_READER_UNLOCK();
+		return result;
+
+
+unlock_retry:
+
+		htmlock(n) = 0;
+		htmlock(p_next) = 0;
+		htmlock(p_prev) = 0;
+		pnodelock(n) = 0;
+		pnodelock(p_next) = 0;
+		pnodelock(p_prev) = 0;
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Deletes a value from a list in NUMA-awared manner, starting from a finger
+ *
+ * Same with rcx_list_numa_remove(), but the traversal starts from *pp_finger if
+ * it is usable, and *pp_finger is updated to the predecessor of the value.
+ * pp_finger could be NULL.
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_finger_remove(list_t *p_list, val_t val, node_t **pp_finger)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	node_t *n;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_start(p_list, pp_finger ? *pp_finger : NULL, val);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		/* p_prev -> p_next -> n */
+
+		if (rcx_numa_unlink(p_prev, p_next, n)) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+		rcx_free_node(p_next);
+	}
+
+	if (pp_finger)
+		*pp_finger = p_prev;
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Deletes a value from a list in NUMA-awared manner
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+int rcx_list_numa_remove(list_t *p_list, val_t val)
+{
+	return rcx_list_finger_remove(p_list, val, NULL);
+}
+
+/*
+ * Find the predecessor of a value in a list, and the node after it
+ *
+ * Caller should be in a RCU read-side critical section.
+ */
+node_t *rcx_list_find(list_t *p_list, val_t val, node_t **pp_next)
+{
+	node_t *p_prev, *p_next;
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_next->val < val) {
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	*pp_next = p_next;
+	return p_prev;
+}
+
+/*
+ * Insert a value with its data into a list unless it is there already
+ *
+ * The lookup and the insert share one traversal, and the absence is decided by
+ * the validation of rcx_numa_link(), so no insert can slip in between.  If the
+ * value is there, its data is stored to *p_data.
+ *
+ * Returns one if the value is in the list already, or zero if inserted.
+ */
+int rcx_list_get_or_add(list_t *p_list, val_t val, val_t data, val_t *p_data)
+{
+	node_t *p_prev, *p_next, *p_new_node;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val == val) {
+		*p_data = READ_ONCE(p_next->data);
+		RCU_READER_UNLOCK();
+		return 1;
+	}
+
+	p_new_node = rcx_new_node();
+	p_new_node->val = val;
+	p_new_node->data = data;
+	p_new_node->p_next = p_next;
+
+	if (rcx_numa_link(p_prev, p_next, p_new_node)) {
+		RCU_READER_UNLOCK();
+		kfree(p_new_node);
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 0;
+}
+
+/*
+ * Replace the data of a value in a list if it equals old_data
+ *
+ * Returns zero if replaced, -ECANCELED if the data differs, or -ENOENT if the
+ * value is not in the list.
+ */
+int rcx_list_compare_replace(list_t *p_list, val_t val, val_t old_data,
+		val_t new_data)
+{
+	node_t *p_prev, *p_next;
+	int ret;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val != val) {
+		ret = -ENOENT;
+	} else if (READ_ONCE(p_next->data) != old_data) {
+		/* Fails fast, and linearizes at the read */
+		ret = -ECANCELED;
+	} else {
+		ret = rcx_numa_replace(p_prev, p_next, old_data, new_data);
+		if (ret == -EAGAIN) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+	}
+
+	RCU_READER_UNLOCK();
+	return ret;
+}
+
+/*
+ * Delete a value from a list if its data equals the given one
+ *
+ * Returns zero if deleted, -ECANCELED if the data differs, or -ENOENT if the
+ * value is not in the list.
+ */
+int rcx_list_remove_if(list_t *p_list, val_t val, val_t data)
+{
+	node_t *p_prev, *p_next;
+	int ret;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val != val) {
+		ret = -ENOENT;
+	} else if (READ_ONCE(p_next->data) != data) {
+		ret = -ECANCELED;
+	} else {
+		ret = rcx_numa_unlink_if(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next), &data);
+		if (ret == -EAGAIN) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+		if (ret == 0)
+			rcx_free_node(p_next);
+	}
+
+	RCU_READER_UNLOCK();
+	return ret;
+}
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Allocate and initialize a hash list
+ */
+hash_list_t *rcx_new_hash_list(int n_buckets)
+{
+	int i;
+	hash_list_t *p_hash_list;
+
+	p_hash_list = kmalloc(sizeof(hash_list_t), GFP_KERNEL);
+
+	if (p_hash_list == NULL)
+		return NULL;
+
+	p_hash_list->n_buckets = n_buckets;
+
+	for (i = 0; i < p_hash_list->n_buckets; i++)
+		p_hash_list->buckets[i] = rcx_new_list(NULL);
+
+	return p_hash_list;
+}
+
+/*
+ * Setup the global hash list
+ */
+int rcx_hash_list_init(int nr_buckets, void *dat)
+{
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	return 0;
+}
+
+/*
+ * Destroy a hash list.
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing the hash list.
+ */
+void rcx_hash_list_destroy(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		rcx_list_destroy(g_hash_list->buckets[hash]);
+		/* This is why the name is destroy, not empty */
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Get number of entries in given hash list
+ */
+__attribute__ ((unused))
+static int hash_list_size(hash_list_t *p_hash_list)
+{
+	int i;
+	int size = 0;
+
+	for (i = 0; i < p_hash_list->n_buckets; i++)
+		size += list_size(p_hash_list->buckets[i]);
+
+	return size;
+}
+
+/*
+ * Check whether a value is in the global hash list
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Open a read-side session on the global hash list
+ *
+ * Lookups done by rcx_hash_list_session_contains() until the matching
+ * rcx_hash_list_read_end() share a single RCU read-side critical section, so
+ * the reader entry and exit are paid once per session rather than once per
+ * lookup.  Sessions should be short, as they delay grace periods.
+ */
+void rcx_hash_list_read_begin(void *tl)
+{
+	RCU_READER_LOCK();
+}
+
+/*
+ * Close a read-side session opened by rcx_hash_list_read_begin()
+ */
+void rcx_hash_list_read_end(void *tl)
+{
+	RCU_READER_UNLOCK();
+}
+
+/*
+ * Check whether a value is in the global hash list inside a read-side session
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_hash_list_session_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	return rcx_list_lookup(g_hash_list->buckets[hash], val) ? 0 : -ENOENT;
+}
+
+static node_t *rcx_batch_deref(void *tl, node_t *p_node)
+{
+	return (node_t *)RCU_DEREF(p_node);
+}
+
+/*
+ * Check whether each of given values is in the global hash list
+ *
+ * Pipelines the traversals with hash_list_amac_contains().
+ *
+ * Stores zero to results[i] if keys[i] exists, -ENOENT else.  Returns the
+ * number of existing keys.
+ */
+int rcx_hash_list_contains_batch(void *tl, val_t *keys, int n, int *results)
+{
+	int nr_found;
+
+	RCU_READER_LOCK();
+	nr_found = hash_list_amac_contains(g_hash_list, keys, n, results,
+			rcx_batch_deref, tl);
+	RCU_READER_UNLOCK();
+
+	return nr_found;
+}
+
+/*
+ * Check whether each of given values is in the global hash list, walking each
+ * bucket only once
+ *
+ * The keys are grouped by bucket and sorted, and each bucket is walked once
+ * with hash_list_merge_contains().  At most MAX_BATCH keys can be given.
+ *
+ * Stores zero to results[i] if keys[i] exists, -ENOENT else.  Returns the
+ * number of existing keys, or -EINVAL if too many keys are given.
+ */
+int rcx_hash_list_contains_merge(void *tl, val_t *keys, int n, int *results)
+{
+	struct batch_probe probes[MAX_BATCH];
+	int nr_found;
+
+	if (n > MAX_BATCH)
+		return -EINVAL;
+
+	hash_list_sort_probes(g_hash_list, keys, n, probes);
+
+	RCU_READER_LOCK();
+	nr_found = hash_list_merge_contains(g_hash_list, probes, n, results,
+			rcx_batch_deref, tl);
+	RCU_READER_UNLOCK();
+
+	return nr_found;
+}
+
+#define SNAPSHOT_HTM_RETRY_LIMIT	10
+#define SNAPSHOT_VALIDATE_RETRY_LIMIT	10
+#define SNAPSHOT_MAX_BACKOFF		(1 << 12)
+
+/*
+ * Find the predecessor of a value in its bucket
+ */
+static inline node_t *snapshot_prev(val_t val)
+{
+	node_t *p_prev, *p_next;
+
+	p_prev = (node_t *)RCU_DEREF(g_hash_list->buckets[
+			HASH_VALUE(g_hash_list, val)]->p_head);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_next->val < val) {
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	return p_prev;
+}
+
+/*
+ * Look up all values in one read-only HTM region
+ *
+ * A predecessor with an odd version is in the middle of a locked transaction,
+ * so the region aborts rather than see half of it.
+ *
+ * Returns _XBEGIN_STARTED if the results are a snapshot, or the abort status.
+ */
+static unsigned int snapshot_htm(val_t *keys, int n, int *results)
+{
+	unsigned int tx_stat;
+	node_t *p_prev;
+	int i;
+
+	RCU_READER_LOCK();
+
+	tx_stat = _xbegin();
+	if (tx_stat == _XBEGIN_STARTED) {
+		for (i = 0; i < n; i++) {
+			p_prev = snapshot_prev(keys[i]);
+			if (p_prev->version & 1)
+				_xabort(ABORT_CONFLICT);
+			results[i] = (p_prev->p_next->val == keys[i]) ?
+				0 : -ENOENT;
+		}
+		_xend();
+	} else {
+		record_abort(tx_stat);
+	}
+
+	RCU_READER_UNLOCK();
+	return tx_stat;
+}
+
+/*
+ * Look up all values and validate them with the versions of the predecessors
+ *
+ * Every change of p_next or removed of an RCX node bumps its version first,
+ * and a locked transaction keeps it odd while it writes.  So if no predecessor
+ * changed between its first read and the validation, all neighbourhoods stayed
+ * as read through a common instant, which the results are a snapshot of.
+ *
+ * Returns zero if the results are a snapshot, -EAGAIN else.
+ */
+static int snapshot_validate(val_t *keys, int n, int *results)
+{
+	node_t *prevs[MAX_BATCH], *nexts[MAX_BATCH];
+	unsigned int versions[MAX_BATCH];
+	int ret = 0;
+	int i;
+
+	RCU_READER_LOCK();
+
+	for (i = 0; i < n; i++) {
+		prevs[i] = snapshot_prev(keys[i]);
+		versions[i] = READ_ONCE(prevs[i]->version);
+		smp_rmb();
+		nexts[i] = (node_t *)RCU_DEREF(READ_ONCE(prevs[i]->p_next));
+		if ((versions[i] & 1) || READ_ONCE(prevs[i]->removed) ||
+				nexts[i]->val < keys[i]) {
+			ret = -EAGAIN;
+			goto out;
+		}
+		results[i] = (nexts[i]->val == keys[i]) ? 0 : -ENOENT;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (READ_ONCE(prevs[i]->p_next) != nexts[i] ||
+				READ_ONCE(prevs[i]->removed)) {
+			ret = -EAGAIN;
+			goto out;
+		}
+	}
+	smp_rmb();
+	for (i = 0; i < n; i++) {
+		if (READ_ONCE(prevs[i]->version) != versions[i]) {
+			ret = -EAGAIN;
+			goto out;
+		}
+	}
+
+out:
+	RCU_READER_UNLOCK();
+	return ret;
+}
+
+/*
+ * Order nodes by address, which is the order several node locks are taken in
+ * with trylock
+ */
+static int node_addr_cmp(const void *a, const void *b)
+{
+	const node_t *pa = *(node_t **)a, *pb = *(node_t **)b;
+
+	if (pa != pb)
+		return pa < pb ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Look up all values with the locks of their predecessors held
+ *
+ * No updater changes p_next of a locked node, so the neighbourhoods all stay
+ * as read while the locks are held.  The locks are taken in address order with
+ * trylock, and the predecessors validated under them, with a backoff retry if
+ * either fails.
+ */
+static void snapshot_locked(val_t *keys, int n, int *results)
+{
+	node_t *prevs[MAX_BATCH], *locks[MAX_BATCH];
+	int nr_locks, nr_locked;
+	int backoff = 1;
+	int ret;
+	int i, j;
+
+	while (1) {
+		ret = 0;
+
+		RCU_READER_LOCK();
+		for (i = 0; i < n; i++)
+			locks[i] = prevs[i] = snapshot_prev(keys[i]);
+		sort(locks, n, sizeof(locks[0]), node_addr_cmp, NULL);
+		for (i = 1, j = 1; i < n; i++)
+			if (locks[i] != locks[j - 1])
+				locks[j++] = locks[i];
+		nr_locks = n ? j : 0;
+
+		for (nr_locked = 0; nr_locked < nr_locks; nr_locked++)
+			if (!spin_trylock(&locks[nr_locked]->global_lock))
+				break;
+
+		/* Spinlock CS. */
+		if (nr_locked < nr_locks)
+			ret = -EAGAIN;
+		for (i = 0; ret == 0 && i < n; i++) {
+			if (prevs[i]->removed ||
+					prevs[i]->p_next->val < keys[i])
+				ret = -EAGAIN;
+			else
+				results[i] =
+					(prevs[i]->p_next->val == keys[i]) ?
+					0 : -ENOENT;
+		}
+
+		for (i = nr_locked - 1; i >= 0; i--)
+			spin_unlock(&locks[i]->global_lock);
+		RCU_READER_UNLOCK();
+
+		if (ret == 0)
+			return;
+
+		for (i = 0; i < backoff; i++)
+			cpu_relax();
+		if (backoff < SNAPSHOT_MAX_BACKOFF)
+			backoff <<= 1;
+	}
+}
+
+/*
+ * Check whether each of given values is in the global hash list, all at one
+ * instant
+ *
+ * Unlike rcx_hash_list_contains_batch(), no multi-key update is seen half
+ * done, so related keys can be read without a lock of their own.  Runs as a
+ * read-only HTM transaction first, and validates the versions of the
+ * predecessors with retries after SNAPSHOT_HTM_RETRY_LIMIT aborts.  After
+ * SNAPSHOT_VALIDATE_RETRY_LIMIT failed validations, it takes the locks of the
+ * predecessors, so a reader is not starved by steady updates.  Only the
+ * commits of rcx_numa_link(), rcx_numa_unlink(), rcx_list_freeze() and the
+ * multi-key commits bump versions, so the other RCX variants should not
+ * update the list meanwhile.  At most MAX_BATCH keys can be given.
+ *
+ * Stores zero to results[i] if keys[i] exists, -ENOENT else.  Returns the
+ * number of existing keys, or -EINVAL if too many keys are given.
+ */
+int rcx_hash_list_contains_snapshot(void *tl, val_t *keys, int n, int *results)
+{
+	int nr_found = 0;
+	int i;
+
+	if (n > MAX_BATCH)
+		return -EINVAL;
+
+	for (i = 0; i < SNAPSHOT_HTM_RETRY_LIMIT; i++) {
+		if (snapshot_htm(keys, n, results) == _XBEGIN_STARTED)
+			goto found;
+	}
+
+	for (i = 0; i < SNAPSHOT_VALIDATE_RETRY_LIMIT; i++) {
+		if (snapshot_validate(keys, n, results) == 0)
+			goto found;
+		cpu_relax();
+	}
+
+	snapshot_locked(keys, n, results);
+
+found:
+	for (i = 0; i < n; i++)
+		if (results[i] == 0)
+			nr_found++;
+
+	return nr_found;
+}
+
+/*
+ * Apply updates of one kind to several values of the global hash list
+ *
+ * The values are grouped by bucket and sorted, duplicates dropped, and each
+ * bucket gets one rcx_list_many() commit.
+ *
+ * Returns the number of values that changed the list, or -EINVAL.
+ */
+static int rcx_hash_list_many(val_t *vals, int n, int op)
+{
+	struct batch_probe probes[MAX_BATCH];
+	val_t bucket_vals[MAX_BATCH];
+	int nr, hash;
+	int nr_changed = 0;
+	int i;
+
+	if (n > MAX_BATCH)
+		return -EINVAL;
+
+	hash_list_sort_probes(g_hash_list, vals, n, probes);
+
+	i = 0;
+	while (i < n) {
+		hash = probes[i].hash;
+		for (nr = 0; i < n && probes[i].hash == hash; i++)
+			if (nr == 0 || bucket_vals[nr - 1] != probes[i].val)
+				bucket_vals[nr++] = probes[i].val;
+
+		nr_changed += rcx_list_many(g_hash_list->buckets[hash],
+				bucket_vals, nr, op);
+	}
+
+	return nr_changed;
+}
+
+/*
+ * Inserts several values into the global hash list
+ *
+ * Values next to each other in a bucket are inserted by one transaction.  At
+ * most MAX_BATCH values can be given.
+ *
+ * Returns the number of values inserted, or -EINVAL if too many values are
+ * given.
+ */
+int rcx_hash_list_add_many(void *tl, val_t *vals, int n)
+{
+	return rcx_hash_list_many(vals, n, RCX_OP_ADD);
+}
+
+/*
+ * Deletes several values from the global hash list
+ *
+ * Values next to each other in a bucket are deleted by one transaction.  At
+ * most MAX_BATCH values can be given.
+ *
+ * Returns the number of values deleted, or -EINVAL if too many values are
+ * given.
+ */
+int rcx_hash_list_remove_many(void *tl, val_t *vals, int n)
+{
+	return rcx_hash_list_many(vals, n, RCX_OP_REMOVE);
+}
+
+/*
+ * Apply a bulk of updates to the global hash list by rebuilding its buckets
+ *
+ * The updates are grouped by bucket and sorted by value, and each bucket they
+ * touch is rebuilt once with rcx_list_rebuild().  Updates of the same value
+ * are applied in their order in updates[], which is left as given, and the
+ * result of each update is stored to its own entry.
+ *
+ * Returns the number of updates that changed the hash list, or -ENOMEM.
+ */
+int rcx_hash_list_rebuild(void *tl, rcx_update_t *updates, int n)
+{
+	struct batch_probe *probes;
+	rcx_update_t *bucket_updates;
+	int nr_changed = 0;
+	int hash, nr;
+	int i, j;
+
+	probes = kmalloc_array(n, sizeof(probes[0]), GFP_KERNEL);
+	bucket_updates = kmalloc_array(n, sizeof(bucket_updates[0]),
+			GFP_KERNEL);
+	if (probes == NULL || bucket_updates == NULL) {
+		kfree(probes);
+		kfree(bucket_updates);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		probes[i].hash = HASH_VALUE(g_hash_list, updates[i].val);
+		probes[i].val = updates[i].val;
+		probes[i].idx = i;
+	}
+	sort(probes, n, sizeof(probes[0]), batch_probe_cmp, NULL);
+
+	for (i = 0; i < n; i += nr) {
+		hash = probes[i].hash;
+		for (nr = 0; i + nr < n && probes[i + nr].hash == hash; nr++)
+			bucket_updates[nr] = updates[probes[i + nr].idx];
+
+		nr_changed += rcx_list_rebuild(g_hash_list->buckets[hash],
+				bucket_updates, nr);
+
+		for (j = 0; j < nr; j++)
+			updates[probes[i + j].idx].result =
+				bucket_updates[j].result;
+	}
+
+	kfree(probes);
+	kfree(bucket_updates);
+	return nr_changed;
+}
+
+/* Most updates in one transaction */
+#define RCX_TXN_MAX		(8)
+#define TXN_HTM_RETRY_LIMIT	10
+/* Explicit abort of a transaction with an update that cannot apply */
+#define ABORT_TXN_UNMET		(0xff)
+#define TXN_MAX_BACKOFF		(1 << 12)
+
+/*
+ * An update of a transaction, and where it applies
+ */
+struct txn_op {
+	rcx_update_t *p_update;
+	int hash;
+	node_t *p_prev;
+	node_t *p_next;
+	node_t *p_succ;		/* successor of p_next, for a delete */
+	node_t *p_new_node;	/* for an insert */
+	node_t *p_removed;	/* unlinked by a delete */
+};
+
+/*
+ * Order updates by bucket, and by descending value within a bucket
+ *
+ * Applied in this order, no update unlinks the predecessor of a later one, so
+ * each can start from the predecessor found before the commit.
+ */
+static int txn_op_cmp(const void *a, const void *b)
+{
+	const struct txn_op *pa = a, *pb = b;
+
+	if (pa->hash != pb->hash)
+		return pa->hash < pb->hash ? -1 : 1;
+	if (pa->p_update->val != pb->p_update->val)
+		return pa->p_update->val > pb->p_update->val ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Find the neighbours of every update.  Caller should be in a read-side
+ * critical section.
+ */
+static void txn_plan(struct txn_op *ops, int nr)
+{
+	node_t *p_prev, *p_next;
+	val_t val;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		val = ops[i].p_update->val;
+		p_prev = (node_t *)RCU_DEREF(
+				g_hash_list->buckets[ops[i].hash]->p_head);
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		while (p_next->val < val) {
+			p_prev = p_next;
+			p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		}
+		ops[i].p_prev = p_prev;
+		ops[i].p_next = p_next;
+		ops[i].p_succ = (node_t *)RCU_DEREF(p_next->p_next);
+		ops[i].p_removed = NULL;
+	}
+}
+
+/*
+ * Apply the updates in order, walking from the planned predecessors
+ *
+ * The walk sees the nodes linked and unlinked by the updates before.  In a
+ * transaction, a locked neighbour or an update that cannot apply aborts it.
+ * Otherwise, caller should hold the locks of all neighbours and have checked
+ * that every update applies.
+ */
+static __always_inline void txn_apply(struct txn_op *ops, int nr, int htm)
+{
+	node_t *p_prev, *p_next, *n;
+	val_t val;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		val = ops[i].p_update->val;
+		p_prev = ops[i].p_prev;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		while (p_next->val < val) {
+			p_prev = p_next;
+			p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		}
+		if (htm && (spin_is_locked(&p_prev->global_lock) ||
+					spin_is_locked(&p_next->global_lock)))
+			_xabort(ABORT_CONFLICT);
+
+		if (ops[i].p_update->op == RCX_OP_ADD) {
+			if (htm && p_next->val == val)
+				_xabort(ABORT_TXN_UNMET);
+			ops[i].p_new_node->p_next = p_next;
+			RCU_ASSIGN_PTR((p_prev->p_next), ops[i].p_new_node);
+		} else {
+			if (htm && p_next->val != val)
+				_xabort(ABORT_TXN_UNMET);
+			n = (node_t *)RCU_DEREF(p_next->p_next);
+			if (htm && spin_is_locked(&n->global_lock))
+				_xabort(ABORT_CONFLICT);
+			RCU_ASSIGN_PTR((p_prev->p_next), n);
+			p_next->removed = 1;
+			ops[i].p_removed = p_next;
 		}
+		ops[i].p_update->result = 1;
+	}
+}
 
-		RCU_ASSIGN_PTR((p_prev->p_next), n);
-		p_next->removed = 1;
-		rcx_free_node(p_next);
-
-		htmlock(n) = 0;
-		htmlock(p_next) = 0;
-		htmlock(p_prev) = 0;
-		pnodelock(n) = 0;
-		pnodelock(p_next) = 0;
-		pnodelock(p_prev) = 0;
+/*
+ * Commit a transaction in one HTM region
+ *
+ * The global locks of the neighbours are only checked, as in
+ * rcx_list_commit_many().  Versions of the written nodes go up by two.
+ *
+ * Returns _XBEGIN_STARTED if committed, or the abort status.
+ */
+static unsigned int txn_commit_htm(struct txn_op *ops, int nr)
+{
+	unsigned int tx_stat;
+	int i;
 
-		RCU_READER_UNLOCK();
-		return result;
+	RCU_READER_LOCK();
+	txn_plan(ops, nr);
 
+	tx_stat = _xbegin();
+	if (tx_stat == _XBEGIN_STARTED) {
+		for (i = 0; i < nr; i++)
+			if (ops[i].p_prev->removed)
+				_xabort(ABORT_DOUBLE_FREE);
 
-unlock_retry:
+		txn_apply(ops, nr, 1);
 
-		htmlock(n) = 0;
-		htmlock(p_next) = 0;
-		htmlock(p_prev) = 0;
-		pnodelock(n) = 0;
-		pnodelock(p_next) = 0;
-		pnodelock(p_prev) = 0;
-		RCU_READER_UNLOCK();
-		goto retry;
+		for (i = 0; i < nr; i++) {
+			ops[i].p_prev->version += 2;
+			if (ops[i].p_removed)
+				ops[i].p_removed->version += 2;
+		}
+		_xend();
+	} else if (!(tx_stat & _XABORT_EXPLICIT) ||
+			_XABORT_CODE(tx_stat) != ABORT_TXN_UNMET) {
+		record_abort(tx_stat);
 	}
 
 	RCU_READER_UNLOCK();
-	return result;
+	return tx_stat;
 }
 
 /*
- * Deletes a value from a list in NUMA-awared manner
+ * Check the planned neighbourhoods under their locks
  *
- * Returns 1 if success, 0 if the list doesn't contain the value.
+ * Returns zero if every update applies, -EAGAIN if the list changed since the
+ * plan, -EEXIST if an insert finds its value, or -ENOENT if a delete doesn't.
  */
-int rcx_list_numa_remove(list_t *p_list, val_t val)
+static int txn_validate(struct txn_op *ops, int nr)
 {
-	int result;
-	node_t *p_prev, *p_next;
-	node_t *p_node;
-	node_t *n;
-	int tx_stat;
-
-retry:
-	RCU_READER_LOCK();
-
-	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
-	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
-	while (1) {
-		p_node = (node_t *)RCU_DEREF(p_next);
+	int ret = 0;
+	int i;
 
-		if (p_node->val >= val)
-			break;
+	for (i = 0; i < nr; i++) {
+		if (ops[i].p_prev->removed || ops[i].p_next->removed ||
+				RCU_DEREF(ops[i].p_prev->p_next) !=
+				ops[i].p_next ||
+				RCU_DEREF(ops[i].p_next->p_next) !=
+				ops[i].p_succ) {
+			record_abort(ABORT_CONFLICT);
+			return -EAGAIN;
+		}
 
-		p_prev = p_next;
-		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+		if (ops[i].p_update->op == RCX_OP_ADD) {
+			if (ops[i].p_next->val == ops[i].p_update->val)
+				ret = -EEXIST;
+		} else {
+			if (ops[i].p_next->val != ops[i].p_update->val)
+				ret = -ENOENT;
+			else if (ops[i].p_succ->removed)
+				return -EAGAIN;
+		}
 	}
 
-	result = (p_node->val == val);
-
-	if (result) {
-		n = (node_t *)RCU_DEREF(p_next->p_next);
-		/* p_prev -> p_next -> n */
+	return ret;
+}
 
-		while (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
-				pnodelock(n) == 1)
-			;
+/*
+ * Commit a transaction holding the global locks of all neighbours
+ *
+ * The locks are tried in address order, and all of them are released with a
+ * growing backoff if one is busy, since RCX commits take them in list order.
+ * Versions of the locked nodes stay odd while the pointers change.
+ *
+ * Returns zero if committed, -EEXIST if an insert found its value, or -ENOENT
+ * if a delete didn't.
+ */
+static int txn_commit_locked(struct txn_op *ops, int nr)
+{
+	node_t *locks[RCX_TXN_MAX * 3];
+	int nr_locks, nr_locked;
+	int backoff = 1;
+	int ret;
+	int i, j;
 
-		tx_stat = _xbegin();
-		if (tx_stat == _XBEGIN_STARTED) {
-			if (pnodelock(p_prev) == 1 || pnodelock(p_next) == 1 ||
-					pnodelock(n) == 1)
-				_xabort(ABORT_CONFLICT);
+	while (1) {
+		ret = -EAGAIN;
 
-			pnodelock(p_prev) = 1;
-			pnodelock(p_next) = 1;
-			pnodelock(n) = 1;
+		RCU_READER_LOCK();
+		txn_plan(ops, nr);
 
-			_xend();
-		} else {
-			RCU_READER_UNLOCK();
-			record_abort(tx_stat);
-			goto retry;
+		nr_locks = 0;
+		for (i = 0; i < nr; i++) {
+			locks[nr_locks++] = ops[i].p_prev;
+			locks[nr_locks++] = ops[i].p_next;
+			if (ops[i].p_update->op == RCX_OP_REMOVE)
+				locks[nr_locks++] = ops[i].p_succ;
 		}
-
-		RCU_WRITER_LOCK(p_prev->global_lock);
-		RCU_WRITER_LOCK(p_next->global_lock);
-		RCU_WRITER_LOCK(n->global_lock);
+		sort(locks, nr_locks, sizeof(locks[0]), node_addr_cmp, NULL);
+		for (i = 1, j = 1; i < nr_locks; i++)
+			if (locks[i] != locks[j - 1])
+				locks[j++] = locks[i];
+		nr_locks = j;
+
+		for (nr_locked = 0; nr_locked < nr_locks; nr_locked++)
+			if (!spin_trylock(&locks[nr_locked]->global_lock))
+				break;
 
 		/* Spinlock CS. */
-		if (p_prev->removed || p_next->removed || n->removed) {
-			RCU_READER_UNLOCK();
-			record_abort(ABORT_DOUBLE_FREE);
-			goto unlock_retry;
-		}
-		if (RCU_DEREF(p_prev->p_next) != p_next ||
-				RCU_DEREF(p_next->p_next) != n) {
-			RCU_READER_UNLOCK();
-			record_abort(ABORT_CONFLICT);
-			goto unlock_retry;
-		}
+		if (nr_locked == nr_locks)
+			ret = txn_validate(ops, nr);
+		if (ret == 0) {
+			for (i = 0; i < nr_locks; i++)
+				locks[i]->version++;
+			smp_wmb();
 
-		RCU_ASSIGN_PTR((p_prev->p_next), n);
-		p_next->removed = 1;
-		rcx_free_node(p_next);
+			txn_apply(ops, nr, 0);
 
-		RCU_WRITER_UNLOCK(n->global_lock);
-		RCU_WRITER_UNLOCK(p_next->global_lock);
-		RCU_WRITER_UNLOCK(p_prev->global_lock);
-		pnodelock(n) = 0;
-		pnodelock(p_next) = 0;
-		pnodelock(p_prev) = 0;
+			smp_wmb();
+			for (i = 0; i < nr_locks; i++)
+				locks[i]->version++;
+		}
 
+		for (i = nr_locked - 1; i >= 0; i--)
+			spin_unlock(&locks[i]->global_lock);
 		RCU_READER_UNLOCK();
-		return result;
-
 
-unlock_retry:
+		if (ret != -EAGAIN)
+			return ret;
 
-		RCU_WRITER_UNLOCK(n->global_lock);
-		RCU_WRITER_UNLOCK(p_next->global_lock);
-		RCU_WRITER_UNLOCK(p_prev->global_lock);
-		pnodelock(n) = 0;
-		pnodelock(p_next) = 0;
-		pnodelock(p_prev) = 0;
-		RCU_READER_UNLOCK();
-		goto retry;
+		for (i = 0; i < backoff; i++)
+			cpu_relax();
+		if (backoff < TXN_MAX_BACKOFF)
+			backoff <<= 1;
 	}
-
-	RCU_READER_UNLOCK();
-	return result;
 }
 
-
-/**************************
- * Hash List
- **************************/
-
 /*
- * Allocate and initialize a hash list
+ * Apply several updates to the global hash list atomically
+ *
+ * Either every update applies or none does: an insert of a value in the list
+ * or a delete of a value not in it fails the whole transaction.  The values
+ * may be in any buckets, but should be distinct.  The transaction commits in
+ * one HTM region, or with the locks of all neighbours after
+ * TXN_HTM_RETRY_LIMIT aborts.  Either way, every pointer changes before any
+ * lock is released, and the versions of the nodes around changed pointers
+ * differ from before.  At most RCX_TXN_MAX updates can be given.
+ *
+ * The result of each update is one if the transaction committed.
+ *
+ * Returns zero if committed, -EEXIST or -ENOENT if an update could not apply,
+ * -EINVAL for bad arguments, or -ENOMEM.
  */
-hash_list_t *rcx_new_hash_list(int n_buckets)
+int rcx_hash_list_txn(void *tl, rcx_update_t *updates, int n)
 {
+	struct txn_op ops[RCX_TXN_MAX];
+	unsigned int tx_stat;
+	int ret = 0;
 	int i;
-	hash_list_t *p_hash_list;
 
-	p_hash_list = kmalloc(sizeof(hash_list_t), GFP_KERNEL);
+	if (n < 1 || n > RCX_TXN_MAX)
+		return -EINVAL;
 
-	if (p_hash_list == NULL)
-		return NULL;
+	for (i = 0; i < n; i++) {
+		ops[i].p_update = &updates[i];
+		ops[i].hash = HASH_VALUE(g_hash_list, updates[i].val);
+		ops[i].p_new_node = NULL;
+		updates[i].result = 0;
+	}
+	sort(ops, n, sizeof(ops[0]), txn_op_cmp, NULL);
 
-	p_hash_list->n_buckets = n_buckets;
+	for (i = 0; i < n; i++) {
+		if (i > 0 && ops[i].p_update->val == ops[i - 1].p_update->val) {
+			ret = -EINVAL;
+			goto out;
+		}
+		if (ops[i].p_update->op != RCX_OP_ADD)
+			continue;
 
-	for (i = 0; i < p_hash_list->n_buckets; i++)
-		p_hash_list->buckets[i] = rcx_new_list();
+		ops[i].p_new_node = rcx_new_node();
+		if (ops[i].p_new_node == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ops[i].p_new_node->val = ops[i].p_update->val;
+	}
 
-	return p_hash_list;
+	for (i = 0; i < TXN_HTM_RETRY_LIMIT; i++) {
+		tx_stat = txn_commit_htm(ops, n);
+		if (tx_stat == _XBEGIN_STARTED)
+			break;
+		/* The locked commit tells which update cannot apply */
+		if ((tx_stat & (_XABORT_CAPACITY | _XABORT_EXPLICIT)) &&
+				_XABORT_CODE(tx_stat) != ABORT_CONFLICT &&
+				_XABORT_CODE(tx_stat) != ABORT_DOUBLE_FREE)
+			break;
+	}
+	if (tx_stat != _XBEGIN_STARTED)
+		ret = txn_commit_locked(ops, n);
+
+out:
+	for (i = 0; i < n; i++) {
+		if (ret == 0 && ops[i].p_removed)
+			rcx_free_node(ops[i].p_removed);
+		if (ret != 0 || !ops[i].p_update->result)
+			kfree(ops[i].p_new_node);
+		if (ret != 0)
+			ops[i].p_update->result = 0;
+	}
+
+	return ret;
 }
 
 /*
- * Setup the global hash list
+ * Move a value of the global hash list to another value atomically
+ *
+ * Returns zero if moved, -ENOENT if the value is not in the list, -EEXIST if
+ * the other value is already, or -EINVAL if they are the same.
  */
-int rcx_hash_list_init(int nr_buckets, void *dat)
+int rcx_hash_list_move(void *tl, val_t from, val_t to)
 {
-	g_hash_list = rcx_new_hash_list(nr_buckets);
-	return 0;
+	rcx_update_t updates[2] = {
+		{.val = from, .op = RCX_OP_REMOVE},
+		{.val = to, .op = RCX_OP_ADD},
+	};
+
+	return rcx_hash_list_txn(tl, updates, 2);
 }
 
 /*
- * Destroy a hash list.
+ * Inserts a value with its data into the global hash list unless it exists
  *
- * Caller of this function should guarantee that there is no other concurrent
- * threads accessing the hash list.
+ * Stores the data of the value to *p_data if it exists.
+ *
+ * Returns zero if inserted, -EEXIST if the value exists
  */
-void rcx_hash_list_destroy(void)
+int rcx_hash_list_get_or_add(void *tl, val_t val, val_t data, val_t *p_data)
 {
-	int hash;
+	int hash = HASH_VALUE(g_hash_list, val);
 
-	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
-		rcx_list_destroy(g_hash_list->buckets[hash]);
-		/* This is why the name is destroy, not empty */
-		kfree(g_hash_list->buckets[hash]);
-	}
-	kfree(g_hash_list);
+	return rcx_list_get_or_add(g_hash_list->buckets[hash], val, data,
+			p_data) ? -EEXIST : 0;
 }
 
 /*
- * Get number of entries in given hash list
+ * Replaces the data of a value in the global hash list if it equals old_data
+ *
+ * Returns zero if replaced, -ECANCELED if the data differs, -ENOENT if the
+ * value doesn't exist
  */
-__attribute__ ((unused))
-static int hash_list_size(hash_list_t *p_hash_list)
+int rcx_hash_list_compare_replace(void *tl, val_t val, val_t old_data,
+		val_t new_data)
 {
-	int i;
-	int size = 0;
-
-	for (i = 0; i < p_hash_list->n_buckets; i++)
-		size += list_size(p_hash_list->buckets[i]);
+	int hash = HASH_VALUE(g_hash_list, val);
 
-	return size;
+	return rcx_list_compare_replace(g_hash_list->buckets[hash], val,
+			old_data, new_data);
 }
 
 /*
- * Check whether a value is in the global hash list
+ * Deletes a value from the global hash list if its data equals the given one
  *
- * Returns zero if exists, -ENOENT else
+ * Returns zero if deleted, -ECANCELED if the data differs, -ENOENT if the
+ * value doesn't exist
  */
-int rcx_hash_list_contains(void *tl, val_t val)
+int rcx_hash_list_remove_if(void *tl, val_t val, val_t data)
 {
 	int hash = HASH_VALUE(g_hash_list, val);
 
-	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
-		0 : -ENOENT;
+	return rcx_list_remove_if(g_hash_list->buckets[hash], val, data);
 }
 
 /*
@@ -1573,3 +3146,115 @@ int rcx_hash_list_numa_remove(void *tl, val_t val)
 	rcx_list_numa_remove(g_hash_list->buckets[hash], val);
 	return 0;
 }
+
+/*
+ * Search fingers of a caller, one per bucket
+ *
+ * A finger remembers a node visited by an operation on its bucket, so that the
+ * next operation on the bucket can start from there.  It is valid only within
+ * the read-side session it was obtained in, so the fingers of earlier sessions
+ * are told apart by their generation, and forgotten all at once.
+ */
+struct finger {
+	unsigned long gen;
+	struct {
+		node_t *p_node;
+		unsigned long gen;
+	} buckets[MAX_BUCKETS];
+};
+
+/*
+ * Allocate the fingers of a caller, all forgotten
+ */
+finger_t *rcx_hash_list_finger_new(void)
+{
+	finger_t *finger = kvzalloc(sizeof(finger_t), GFP_KERNEL);
+
+	if (finger == NULL)
+		return NULL;
+
+	finger->gen = 1;
+	return finger;
+}
+
+void rcx_hash_list_finger_free(finger_t *finger)
+{
+	kvfree(finger);
+}
+
+/*
+ * Forget the fingers, which should be done when a read-side session begins
+ */
+void rcx_hash_list_finger_reset(finger_t *finger)
+{
+	finger->gen++;
+}
+
+/*
+ * Get the start node of the finger of a bucket, or NULL if it is forgotten
+ */
+static node_t *finger_node(finger_t *finger, int hash)
+{
+	if (finger->buckets[hash].gen != finger->gen)
+		return NULL;
+	return finger->buckets[hash].p_node;
+}
+
+static void finger_set(finger_t *finger, int hash, node_t *p_node)
+{
+	finger->buckets[hash].p_node = p_node;
+	finger->buckets[hash].gen = finger->gen;
+}
+
+/*
+ * Check whether a value is in the global hash list, starting from a finger
+ *
+ * Should be called inside a read-side session (rcx_hash_list_read_begin()),
+ * with the fingers reset when the session began.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_hash_list_finger_contains(void *tl, val_t val, finger_t *finger)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	node_t *p_node = finger_node(finger, hash);
+	int result;
+
+	result = rcx_list_finger_contains(g_hash_list->buckets[hash], val,
+			&p_node);
+	finger_set(finger, hash, p_node);
+
+	return result ? 0 : -ENOENT;
+}
+
+/*
+ * Finger version of rcx_hash_list_numa_add()
+ *
+ * Returns zero only
+ */
+int rcx_hash_list_finger_add(void *tl, val_t val, finger_t *finger)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	node_t *p_node = finger_node(finger, hash);
+
+	rcx_list_finger_add(g_hash_list->buckets[hash], val, &p_node);
+	finger_set(finger, hash, p_node);
+
+	return 0;
+}
+
+/*
+ * Finger version of rcx_hash_list_numa_remove()
+ *
+ * Returns zero only
+ */
+int rcx_hash_list_finger_remove(void *tl, val_t val, finger_t *finger)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	node_t *p_node = finger_node(finger, hash);
+
+	rcx_list_finger_remove(g_hash_list->buckets[hash], val, &p_node);
+	finger_set(finger, hash, p_node);
+
+	return 0;
+}
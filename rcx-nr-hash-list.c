@@ -0,0 +1,380 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/topology.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+#define RCU_ASSIGN_PTR(p_ptr, p_obj)    rcu_assign_pointer(p_ptr, p_obj)
+
+#define RCU_DEREF(p_obj)                (p_obj)
+#define RCU_FREE(ptr)                   kfree_rcu(ptr, rcu)
+
+/* Entries of the shared log, a power of two */
+#define NR_LOG_SIZE		(4096)
+
+/*
+ * Entry of the shared log
+ *
+ * The entry of log index i is filled once its stamp reads i + 1.
+ */
+typedef struct nr_entry {
+	unsigned long stamp;
+	val_t val;
+	int op;
+} nr_entry_t;
+
+/*
+ * Replica of the table on one NUMA node
+ *
+ * All of its memory is on its node.  Updates are replayed from the log in
+ * order by the holder of the replay lock, and readers traverse it as RCU
+ * readers meanwhile.
+ */
+typedef struct nr_replica {
+	struct mutex replay;
+	int nodeid;
+	/* log entries applied so far, read by every node */
+	unsigned long __attribute__((aligned(CACHELINE_SIZE))) applied;
+	hash_list_t __attribute__((aligned(CACHELINE_SIZE))) table;
+} nr_replica_t;
+
+__cacheline_aligned static nr_entry_t *g_log;
+/* Log entries reserved by updaters */
+__cacheline_aligned static atomic_long_t g_log_tail;
+/* Log entries applied by at least one replica */
+__cacheline_aligned static unsigned long g_log_completed;
+
+/* NUMA nodes with cpus, one replica on each */
+static int g_nr_nodes[NR_NUMA_NODES];
+static int g_nr_nr_nodes;
+static nr_replica_t *g_replicas[NR_NUMA_NODES];
+
+/*
+ * Replica of the running thread
+ *
+ * Benchmark threads are bound to cpus, so this is the replica of their node.
+ */
+static inline nr_replica_t *nr_local_replica(void)
+{
+	int node = numa_node_id();
+
+	if (node >= NR_NUMA_NODES || g_replicas[node] == NULL)
+		return g_replicas[g_nr_nodes[0]];
+	return g_replicas[node];
+}
+
+/*
+ * Allocate a node of a replica
+ */
+static node_t *nr_new_node(int nodeid, val_t val, node_t *p_next)
+{
+	node_t *p_new_node = kmalloc_node(sizeof(node_t), GFP_KERNEL, nodeid);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	p_new_node->val = val;
+	p_new_node->p_next = p_next;
+	p_new_node->removed = 0;
+
+	return p_new_node;
+}
+
+/*
+ * Apply one log entry to a list of a replica
+ *
+ * Caller should hold the replay lock of the replica.
+ */
+static void nr_list_apply(list_t *p_list, int nodeid, val_t val, int op)
+{
+	node_t *p_prev, *p_node, *p_new_node;
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_node = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_node->val < val) {
+		p_prev = p_node;
+		p_node = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	if (op == RCX_OP_ADD && p_node->val != val) {
+		/* Every replica should fail the same, so retry */
+		while ((p_new_node = nr_new_node(nodeid, val, p_node)) == NULL)
+			cond_resched();
+		RCU_ASSIGN_PTR((p_prev->p_next), p_new_node);
+	} else if (op == RCX_OP_REMOVE && p_node->val == val) {
+		RCU_ASSIGN_PTR((p_prev->p_next), p_node->p_next);
+		RCU_FREE(p_node);
+	}
+}
+
+/*
+ * Replay the log into a replica up to an index
+ *
+ * Stops early at an entry not filled yet if nowait.  Caller should hold the
+ * replay lock of the replica.
+ */
+static void nr_replay(nr_replica_t *p_replica, unsigned long upto, int nowait)
+{
+	unsigned long idx = p_replica->applied;
+	unsigned long completed;
+	nr_entry_t *p_entry;
+	list_t *p_list;
+	int hash;
+
+	while (idx < upto) {
+		p_entry = &g_log[idx & (NR_LOG_SIZE - 1)];
+		while (smp_load_acquire(&p_entry->stamp) != idx + 1) {
+			if (nowait)
+				goto out;
+			cpu_relax();
+		}
+
+		hash = HASH_VALUE((&p_replica->table), p_entry->val);
+		p_list = p_replica->table.buckets[hash];
+		nr_list_apply(p_list, p_replica->nodeid, p_entry->val,
+				p_entry->op);
+		idx++;
+		smp_store_release(&p_replica->applied, idx);
+	}
+
+out:
+	completed = READ_ONCE(g_log_completed);
+	while (completed < idx)
+		completed = cmpxchg(&g_log_completed, completed, idx);
+}
+
+/*
+ * Wait until every replica has applied the entries before an index
+ *
+ * A lagging replica is replayed from here when its lock is free.
+ */
+static void nr_wait_replicas(unsigned long upto)
+{
+	nr_replica_t *p_replica;
+	int i;
+
+	for (i = 0; i < g_nr_nr_nodes; i++) {
+		p_replica = g_replicas[g_nr_nodes[i]];
+
+		while (smp_load_acquire(&p_replica->applied) < upto) {
+			if (mutex_trylock(&p_replica->replay)) {
+				nr_replay(p_replica, upto, 1);
+				mutex_unlock(&p_replica->replay);
+			}
+			cpu_relax();
+		}
+	}
+}
+
+/*
+ * Insert or delete a value
+ *
+ * Appends the update to the shared log, and replays the local replica up to
+ * it.  The other replicas catch up when their readers or updaters need it.
+ */
+static void nr_update(val_t val, int op)
+{
+	nr_replica_t *p_replica = nr_local_replica();
+	unsigned long idx = atomic_long_inc_return(&g_log_tail) - 1;
+	nr_entry_t *p_entry = &g_log[idx & (NR_LOG_SIZE - 1)];
+
+	/* The entry is reused once every replica has applied it */
+	if (idx >= NR_LOG_SIZE)
+		nr_wait_replicas(idx - NR_LOG_SIZE + 1);
+
+	p_entry->val = val;
+	p_entry->op = op;
+	smp_store_release(&p_entry->stamp, idx + 1);
+
+	mutex_lock(&p_replica->replay);
+	nr_replay(p_replica, idx + 1, 0);
+	mutex_unlock(&p_replica->replay);
+}
+
+static void nr_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+/*
+ * Allocate and initialize the replica of a NUMA node
+ */
+static nr_replica_t *nr_new_replica(int nodeid, int n_buckets)
+{
+	nr_replica_t *p_replica;
+	list_t *p_list;
+	node_t *p_max_node;
+	int i;
+
+	p_replica = kzalloc_node(sizeof(nr_replica_t), GFP_KERNEL, nodeid);
+	if (p_replica == NULL)
+		return NULL;
+
+	mutex_init(&p_replica->replay);
+	p_replica->nodeid = nodeid;
+	p_replica->table.n_buckets = n_buckets;
+
+	for (i = 0; i < n_buckets; i++) {
+		p_list = kmalloc_node(sizeof(list_t), GFP_KERNEL, nodeid);
+		if (p_list == NULL)
+			goto fail;
+		p_list->p_head = NULL;
+		p_replica->table.buckets[i] = p_list;
+
+		p_max_node = nr_new_node(nodeid, LIST_VAL_MAX, NULL);
+		if (p_max_node == NULL)
+			goto fail;
+		p_list->p_head = nr_new_node(nodeid, LIST_VAL_MIN, p_max_node);
+		if (p_list->p_head == NULL) {
+			kfree(p_max_node);
+			goto fail;
+		}
+	}
+
+	return p_replica;
+
+fail:
+	for (i = 0; i < n_buckets && p_replica->table.buckets[i]; i++) {
+		nr_list_destroy(p_replica->table.buckets[i]);
+		kfree(p_replica->table.buckets[i]);
+	}
+	kfree(p_replica);
+	return NULL;
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global node replicated hash list
+ *
+ * One replica per NUMA node with cpus, and the shared log.
+ */
+int rcx_nr_hash_list_init(int nr_buckets, void *dat)
+{
+	int node;
+
+	g_log = kzalloc(NR_LOG_SIZE * sizeof(nr_entry_t), GFP_KERNEL);
+	if (g_log == NULL)
+		return -ENOMEM;
+	atomic_long_set(&g_log_tail, 0);
+	g_log_completed = 0;
+
+	g_nr_nr_nodes = 0;
+	for_each_node_with_cpus(node) {
+		if (node >= NR_NUMA_NODES)
+			break;
+		g_nr_nodes[g_nr_nr_nodes++] = node;
+
+		g_replicas[node] = nr_new_replica(node, nr_buckets);
+		if (g_replicas[node] == NULL) {
+			rcx_nr_hash_list_destroy();
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Destroy the global node replicated hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_nr_hash_list_destroy(void)
+{
+	nr_replica_t *p_replica;
+	int i, hash;
+
+	/* Replayed nodes may be freed with kfree_rcu() still */
+	rcu_barrier();
+
+	for (i = 0; i < g_nr_nr_nodes; i++) {
+		p_replica = g_replicas[g_nr_nodes[i]];
+		if (p_replica == NULL)
+			continue;
+
+		for (hash = 0; hash < p_replica->table.n_buckets; hash++) {
+			nr_list_destroy(p_replica->table.buckets[hash]);
+			kfree(p_replica->table.buckets[hash]);
+		}
+		kfree(p_replica);
+		g_replicas[g_nr_nodes[i]] = NULL;
+	}
+	kfree(g_log);
+}
+
+/*
+ * Check whether a value is in the global node replicated hash list
+ *
+ * Reads the local replica only, after it has caught up with the updates
+ * completed before the lookup started.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_nr_hash_list_contains(void *tl, val_t val)
+{
+	nr_replica_t *p_replica = nr_local_replica();
+	unsigned long completed = READ_ONCE(g_log_completed);
+	node_t *p_node;
+	list_t *p_list;
+	int result;
+
+	while (smp_load_acquire(&p_replica->applied) < completed) {
+		if (mutex_trylock(&p_replica->replay)) {
+			nr_replay(p_replica, completed, 0);
+			mutex_unlock(&p_replica->replay);
+		}
+		cpu_relax();
+	}
+
+	p_list = p_replica->table.buckets[HASH_VALUE((&p_replica->table), val)];
+
+	RCU_READER_LOCK();
+
+	p_node = (node_t *)RCU_DEREF(p_list->p_head);
+	while (p_node->val < val)
+		p_node = (node_t *)RCU_DEREF(p_node->p_next);
+	result = (p_node->val == val);
+
+	RCU_READER_UNLOCK();
+
+	return result ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global node replicated hash list
+ *
+ * Returns zero only
+ */
+int rcx_nr_hash_list_add(void *tl, val_t val)
+{
+	nr_update(val, RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global node replicated hash list
+ *
+ * Returns zero only
+ */
+int rcx_nr_hash_list_remove(void *tl, val_t val)
+{
+	nr_update(val, RCX_OP_REMOVE);
+	return 0;
+}
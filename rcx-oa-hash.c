@@ -0,0 +1,357 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/mm.h>    // kvmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+
+
+#include "hash-list.h"
+#include "rtm.h"
+#include "rtm_debug.h"
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_WRITER_LOCK(lock)           spin_lock(&lock)
+#define RCU_WRITER_UNLOCK(lock)         spin_unlock(&lock)
+
+/*
+ * Slots hold the values themselves, so a lookup touches the home group and
+ * usually nothing else.  Keys are non-negative, which leaves the negative
+ * values free for the slot states.
+ */
+#define OA_EMPTY		(LIST_VAL_MIN)
+#define OA_TOMB			(LIST_VAL_MIN + 1)
+#define OA_SLOTS_PER_GROUP	(CACHELINE_SIZE / sizeof(val_t))
+
+/* Number of transactions tried before taking the home group lock */
+#define OA_HTM_RETRY_LIMIT	(10)
+
+typedef struct oa_group {
+	val_t slots[OA_SLOTS_PER_GROUP];
+} __attribute__((aligned(CACHELINE_SIZE))) oa_group_t;
+
+/*
+ * Open addressing table
+ *
+ * A value is probed from its home group over the following groups, and the
+ * probe stops at the first empty slot, so every value sits before the first
+ * empty slot of its probe sequence.  Removed values leave a tombstone, and a
+ * run of tombstones followed by an empty slot is emptied again by removes in a
+ * transaction, since no probe through the run can reach a value beyond it.
+ * Updates of a value are serialized on its home group, by lock elision over
+ * the home group lock.
+ */
+typedef struct oa_table {
+	unsigned int group_bits;
+	unsigned long n_groups;
+	oa_group_t *groups;
+	aligned_spinlock_t *locks;	/* lock of each home group */
+} oa_table_t;
+
+__cacheline_aligned static oa_table_t *g_oa_table;
+
+static inline unsigned long oa_home(oa_table_t *p_table, val_t val)
+{
+	return hash_32(val, p_table->group_bits);
+}
+
+/*
+ * Neighbour slots in the probe order, which wraps around the table
+ */
+static inline val_t *oa_next_slot(oa_table_t *p_table, val_t *p_slot)
+{
+	val_t *p_first = &p_table->groups[0].slots[0];
+	unsigned long n_slots = p_table->n_groups * OA_SLOTS_PER_GROUP;
+
+	return &p_first[(p_slot - p_first + 1) % n_slots];
+}
+
+static inline val_t *oa_prev_slot(oa_table_t *p_table, val_t *p_slot)
+{
+	val_t *p_first = &p_table->groups[0].slots[0];
+	unsigned long n_slots = p_table->n_groups * OA_SLOTS_PER_GROUP;
+
+	return &p_first[(p_slot - p_first + n_slots - 1) % n_slots];
+}
+
+/*
+ * Probe for a value from its home group
+ *
+ * If pp_free is given, it gets the first empty or tombstone slot on the way,
+ * or NULL if the table is full.
+ *
+ * Returns the slot holding the value, or NULL if there is none.
+ */
+static val_t *oa_probe(oa_table_t *p_table, val_t val, val_t **pp_free)
+{
+	unsigned long group = oa_home(p_table, val);
+	unsigned long n;
+	val_t *p_slot;
+	val_t v;
+	int i;
+
+	if (pp_free)
+		*pp_free = NULL;
+
+	for (n = 0; n < p_table->n_groups; n++) {
+		for (i = 0; i < OA_SLOTS_PER_GROUP; i++) {
+			p_slot = &p_table->groups[group].slots[i];
+			v = READ_ONCE(*p_slot);
+
+			if (v == val)
+				return p_slot;
+			if (v == OA_EMPTY || v == OA_TOMB) {
+				if (pp_free && *pp_free == NULL)
+					*pp_free = p_slot;
+				if (v == OA_EMPTY)
+					return NULL;
+			}
+		}
+		group = (group + 1) & (p_table->n_groups - 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * Empty the run of tombstones ending at a slot, if an empty slot follows it
+ *
+ * Should be called in a transaction only.  The next slot is then in the read
+ * set, so an insert of another home group that claims it aborts the reclaim,
+ * and the check and the emptying of each tombstone are one atomic step.
+ */
+static void oa_reclaim(oa_table_t *p_table, val_t *p_slot)
+{
+	unsigned long n;
+
+	for (n = 0; n < p_table->n_groups * OA_SLOTS_PER_GROUP; n++) {
+		if (*oa_next_slot(p_table, p_slot) != OA_EMPTY ||
+				*p_slot != OA_TOMB)
+			break;
+		*p_slot = OA_EMPTY;
+		p_slot = oa_prev_slot(p_table, p_slot);
+	}
+}
+
+/*
+ * Check whether a value is in the table
+ *
+ * Returns one if exists, zero else
+ */
+static int oa_contains(oa_table_t *p_table, val_t val)
+{
+	int result;
+
+	RCU_READER_LOCK();
+	result = (oa_probe(p_table, val, NULL) != NULL);
+	RCU_READER_UNLOCK();
+
+	return result;
+}
+
+/*
+ * Insert a value into the table
+ *
+ * Runs the probe and the claim of a free slot in one transaction.  A free
+ * slot is claimed with cmpxchg under the home group lock on the fallback,
+ * since updaters of other home groups may claim the same slot.  The slot may
+ * be behind a run emptied by oa_reclaim() since the probe, so the value is
+ * probed again, and moved to an earlier free slot until it is reachable.
+ * Lookups don't see it until then.  Once reachable, it stays so, since a run
+ * is emptied only if the slot after it is empty, atomically with the check.
+ *
+ * Returns one if inserted, zero if the value is in the table already or the
+ * table is full.
+ */
+static int oa_add(oa_table_t *p_table, val_t val)
+{
+	spinlock_t *p_lock = &p_table->locks[oa_home(p_table, val)].lock;
+	val_t *p_slot, *p_free;
+	val_t v;
+	int tx_stat;
+	int retry;
+	int result;
+
+	for (retry = 0; retry < OA_HTM_RETRY_LIMIT; retry++) {
+		while (spin_is_locked(p_lock))
+			;
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(p_lock))
+				_xabort(ABORT_LF_CONFLICT);
+
+			p_slot = oa_probe(p_table, val, &p_free);
+			result = (p_slot == NULL && p_free != NULL);
+			if (result)
+				*p_free = val;
+			_xend();
+			return result;
+		}
+		record_abort(tx_stat);
+	}
+
+	RCU_WRITER_LOCK(*p_lock);
+	while (1) {
+		p_slot = oa_probe(p_table, val, &p_free);
+		result = (p_slot == NULL && p_free != NULL);
+		if (!result)
+			break;
+
+		v = READ_ONCE(*p_free);
+		if ((v == OA_EMPTY || v == OA_TOMB) &&
+				cmpxchg(p_free, v, val) == v)
+			break;
+	}
+
+	/* Only this updater writes val, so the first hit is p_free */
+	while (result && oa_probe(p_table, val, &p_slot) == NULL) {
+		v = READ_ONCE(*p_slot);
+		if ((v == OA_EMPTY || v == OA_TOMB) &&
+				cmpxchg(p_slot, v, val) == v) {
+			WRITE_ONCE(*p_free, OA_TOMB);
+			p_free = p_slot;
+		}
+	}
+	RCU_WRITER_UNLOCK(*p_lock);
+
+	return result;
+}
+
+/*
+ * Delete a value from the table
+ *
+ * Only the updaters of the value write a slot holding it, so the tombstone is
+ * a plain store.  In a transaction, the tombstone is then reclaimed with the
+ * run before it, if an empty slot follows.  The lock fallback leaves it to a
+ * later remove, since its check of the next slot would not be atomic.
+ *
+ * Returns one if deleted, zero if the table doesn't contain the value.
+ */
+static int oa_remove(oa_table_t *p_table, val_t val)
+{
+	spinlock_t *p_lock = &p_table->locks[oa_home(p_table, val)].lock;
+	val_t *p_slot;
+	int tx_stat;
+	int retry;
+
+	for (retry = 0; retry < OA_HTM_RETRY_LIMIT; retry++) {
+		while (spin_is_locked(p_lock))
+			;
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(p_lock))
+				_xabort(ABORT_LF_CONFLICT);
+
+			p_slot = oa_probe(p_table, val, NULL);
+			if (p_slot) {
+				*p_slot = OA_TOMB;
+				oa_reclaim(p_table, p_slot);
+			}
+			_xend();
+			return p_slot != NULL;
+		}
+		record_abort(tx_stat);
+	}
+
+	RCU_WRITER_LOCK(*p_lock);
+	p_slot = oa_probe(p_table, val, NULL);
+	if (p_slot)
+		WRITE_ONCE(*p_slot, OA_TOMB);
+	RCU_WRITER_UNLOCK(*p_lock);
+
+	return p_slot != NULL;
+}
+
+
+/**************************
+ * Hash Table
+ **************************/
+
+/*
+ * Setup the global open addressing table
+ *
+ * The table is sized for a load factor of at most one half over the key range
+ * in the bench_conf_t given as dat.  nr_buckets is not used.
+ */
+int rcx_oa_hash_init(int nr_buckets, void *dat)
+{
+	bench_conf_t *p_conf = dat;
+	unsigned long n_slots;
+	unsigned long i;
+	int j;
+
+	g_oa_table = kmalloc(sizeof(oa_table_t), GFP_KERNEL);
+	if (g_oa_table == NULL)
+		return -ENOMEM;
+
+	n_slots = roundup_pow_of_two(2 * max(p_conf->range, 1));
+	/* hash_32() needs at least one bit */
+	g_oa_table->n_groups = max(n_slots / OA_SLOTS_PER_GROUP, 2UL);
+	g_oa_table->group_bits = ilog2(g_oa_table->n_groups);
+
+	g_oa_table->groups = kvmalloc(g_oa_table->n_groups * sizeof(oa_group_t),
+			GFP_KERNEL);
+	g_oa_table->locks = kvmalloc(g_oa_table->n_groups *
+			sizeof(aligned_spinlock_t), GFP_KERNEL);
+	if (g_oa_table->groups == NULL || g_oa_table->locks == NULL) {
+		kvfree(g_oa_table->groups);
+		kvfree(g_oa_table->locks);
+		kfree(g_oa_table);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < g_oa_table->n_groups; i++) {
+		for (j = 0; j < OA_SLOTS_PER_GROUP; j++)
+			g_oa_table->groups[i].slots[j] = OA_EMPTY;
+		spin_lock_init(&g_oa_table->locks[i].lock);
+	}
+
+	return 0;
+}
+
+/*
+ * Destroy the global open addressing table
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_oa_hash_destroy(void)
+{
+	kvfree(g_oa_table->groups);
+	kvfree(g_oa_table->locks);
+	kfree(g_oa_table);
+}
+
+/*
+ * Check whether a value is in the global open addressing table
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_oa_hash_contains(void *tl, val_t val)
+{
+	return oa_contains(g_oa_table, val) ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global open addressing table
+ *
+ * Returns zero only
+ */
+int rcx_oa_hash_add(void *tl, val_t val)
+{
+	oa_add(g_oa_table, val);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global open addressing table
+ *
+ * Returns zero only
+ */
+int rcx_oa_hash_remove(void *tl, val_t val)
+{
+	oa_remove(g_oa_table, val);
+	return 0;
+}
@@ -0,0 +1,328 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/mm.h>    // kvmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sort.h>
+#include <linux/timex.h>  // get_cycles
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+/* Entries of a per-cpu log, appended until it is full */
+#define OPLOG_SIZE		(1024)
+
+/*
+ * Entry of a per-cpu log
+ *
+ * Timestamped with the cycle counter, which is assumed to be synchronized
+ * among cpus (constant_tsc).
+ */
+typedef struct oplog_entry {
+	cycles_t ts;
+	val_t val;
+	int op;
+} oplog_entry_t;
+
+/*
+ * Update log of a cpu
+ *
+ * The lock is taken by the updaters of the cpu and by the merger only, so it
+ * is barely contended.
+ */
+typedef struct oplog {
+	struct mutex lock;
+	int nr;
+	oplog_entry_t entries[OPLOG_SIZE];
+} ____cacheline_aligned oplog_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static DEFINE_PER_CPU(oplog_t *, oplog);
+
+/* Serializes merges, and holds the merged entries */
+static DEFINE_MUTEX(g_merge_lock);
+static oplog_entry_t *g_merge_entries;
+static rcx_update_t *g_merge_updates;
+
+/*
+ * Order entries by bucket, then value, then time
+ */
+static int oplog_entry_cmp(const void *a, const void *b)
+{
+	const oplog_entry_t *p_a = a;
+	const oplog_entry_t *p_b = b;
+	int hash_a = HASH_VALUE(g_hash_list, p_a->val);
+	int hash_b = HASH_VALUE(g_hash_list, p_b->val);
+
+	if (hash_a != hash_b)
+		return hash_a < hash_b ? -1 : 1;
+	if (p_a->val != p_b->val)
+		return p_a->val < p_b->val ? -1 : 1;
+	if (p_a->ts != p_b->ts)
+		return p_a->ts < p_b->ts ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Collect the last update of each value from sorted entries
+ *
+ * Returns the number of updates.
+ */
+static int oplog_last_updates(oplog_entry_t *entries, int nr,
+		rcx_update_t *updates)
+{
+	int i, nr_updates = 0;
+
+	for (i = 0; i < nr; i++) {
+		if (i + 1 < nr && entries[i + 1].val == entries[i].val)
+			continue;
+
+		updates[nr_updates].val = entries[i].val;
+		updates[nr_updates].op = entries[i].op;
+		nr_updates++;
+	}
+
+	return nr_updates;
+}
+
+/*
+ * Fold every log entry stamped before now into the table
+ *
+ * The logs are drained one by one, so an entry stamped after the cutoff is
+ * left in its log for the next merge, even if its log is drained after it is
+ * appended.  Each merge thus applies all entries before its cutoff and none
+ * after, and merges follow the timestamp order.  An entry stamped before the
+ * cutoff is in its log by the time the log is locked, since it is stamped
+ * under the lock.
+ *
+ * The drained entries are sorted together.  In a set only the last update of
+ * a value decides whether it is in, so only that one is applied, and each
+ * bucket is updated in one rcx_list_apply() pass.
+ */
+static void oplog_merge(void)
+{
+	oplog_t *p_log;
+	cycles_t cutoff;
+	int nr = 0, nr_entries, nr_updates, nr_taken;
+	int cpu, i, hash;
+
+	mutex_lock(&g_merge_lock);
+
+	cutoff = get_cycles();
+	for_each_possible_cpu(cpu) {
+		p_log = per_cpu(oplog, cpu);
+		if (p_log == NULL || READ_ONCE(p_log->nr) == 0)
+			continue;
+
+		mutex_lock(&p_log->lock);
+		/* Entries of a log are in timestamp order */
+		for (nr_taken = 0; nr_taken < p_log->nr; nr_taken++)
+			if (p_log->entries[nr_taken].ts >= cutoff)
+				break;
+		memcpy(&g_merge_entries[nr], p_log->entries,
+				nr_taken * sizeof(oplog_entry_t));
+		memmove(p_log->entries, &p_log->entries[nr_taken],
+				(p_log->nr - nr_taken) * sizeof(oplog_entry_t));
+		nr += nr_taken;
+		WRITE_ONCE(p_log->nr, p_log->nr - nr_taken);
+		mutex_unlock(&p_log->lock);
+	}
+
+	sort(g_merge_entries, nr, sizeof(oplog_entry_t), oplog_entry_cmp, NULL);
+
+	for (i = 0; i < nr; i += nr_entries) {
+		hash = HASH_VALUE(g_hash_list, g_merge_entries[i].val);
+		nr_entries = 1;
+		while (i + nr_entries < nr && HASH_VALUE(g_hash_list,
+				g_merge_entries[i + nr_entries].val) == hash)
+			nr_entries++;
+
+		nr_updates = oplog_last_updates(&g_merge_entries[i],
+				nr_entries, g_merge_updates);
+		rcx_list_apply(g_hash_list->buckets[hash], g_merge_updates,
+				nr_updates);
+	}
+
+	mutex_unlock(&g_merge_lock);
+}
+
+/*
+ * Append an update to the log of this cpu
+ *
+ * A full log is merged first, without holding its lock.
+ */
+static void oplog_append(val_t val, int op)
+{
+	oplog_t *p_log;
+
+	while (1) {
+		p_log = per_cpu(oplog, raw_smp_processor_id());
+
+		mutex_lock(&p_log->lock);
+		if (p_log->nr < OPLOG_SIZE) {
+			p_log->entries[p_log->nr].ts = get_cycles();
+			p_log->entries[p_log->nr].val = val;
+			p_log->entries[p_log->nr].op = op;
+			WRITE_ONCE(p_log->nr, p_log->nr + 1);
+			mutex_unlock(&p_log->lock);
+			return;
+		}
+		mutex_unlock(&p_log->lock);
+
+		oplog_merge();
+	}
+}
+
+/*
+ * Whether an update may be pending
+ *
+ * The logs are checked before the merge lock, so an update drained by a merge
+ * still applying it is seen through the lock.
+ */
+static int oplog_pending(void)
+{
+	oplog_t *p_log;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		p_log = per_cpu(oplog, cpu);
+		if (p_log && READ_ONCE(p_log->nr))
+			return 1;
+	}
+
+	smp_rmb();
+	return mutex_is_locked(&g_merge_lock);
+}
+
+static void oplog_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(iter);
+	}
+}
+
+static void oplog_free_table(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		oplog_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+static void oplog_free_logs(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(oplog, cpu));
+		per_cpu(oplog, cpu) = NULL;
+	}
+	kvfree(g_merge_entries);
+	kvfree(g_merge_updates);
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global update log hash list
+ *
+ * Each cpu gets a log on its own NUMA node.
+ */
+int rcx_oplog_hash_list_init(int nr_buckets, void *dat)
+{
+	oplog_t *p_log;
+	int cpu, nr_cpus = 0;
+
+	g_hash_list = rcx_new_hash_list(nr_buckets);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		p_log = kmalloc_node(sizeof(oplog_t), GFP_KERNEL,
+				cpu_to_node(cpu));
+		if (p_log == NULL)
+			goto fail;
+		mutex_init(&p_log->lock);
+		p_log->nr = 0;
+		per_cpu(oplog, cpu) = p_log;
+		nr_cpus++;
+	}
+
+	g_merge_entries = kvmalloc(nr_cpus * OPLOG_SIZE * sizeof(oplog_entry_t),
+			GFP_KERNEL);
+	g_merge_updates = kvmalloc(nr_cpus * OPLOG_SIZE * sizeof(rcx_update_t),
+			GFP_KERNEL);
+	if (g_merge_entries == NULL || g_merge_updates == NULL)
+		goto fail;
+
+	return 0;
+
+fail:
+	oplog_free_logs();
+	oplog_free_table();
+	return -ENOMEM;
+}
+
+/*
+ * Destroy the global update log hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_oplog_hash_list_destroy(void)
+{
+	oplog_free_logs();
+	oplog_free_table();
+}
+
+/*
+ * Check whether a value is in the global update log hash list
+ *
+ * Merges the pending updates first, if any.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_oplog_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	if (oplog_pending())
+		oplog_merge();
+
+	return rcx_list_contains(g_hash_list->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global update log hash list
+ *
+ * Returns zero only
+ */
+int rcx_oplog_hash_list_add(void *tl, val_t val)
+{
+	oplog_append(val, RCX_OP_ADD);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global update log hash list
+ *
+ * Returns zero only
+ */
+int rcx_oplog_hash_list_remove(void *tl, val_t val)
+{
+	oplog_append(val, RCX_OP_REMOVE);
+	return 0;
+}
@@ -0,0 +1,483 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/random.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_skip_hash, val)    (val % p_skip_hash->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+#define RCU_ASSIGN_PTR(p_ptr, p_obj)    rcu_assign_pointer(p_ptr, p_obj)
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+/* Number of index levels above the bottom level */
+#define SL_MAX_LEVEL	(16)
+/* A node reaches each index level with 1/(1 << SL_LEVEL_SHIFT) probability */
+#define SL_LEVEL_SHIFT	(2)
+
+/*
+ * Skip list node
+ *
+ * The bottom level is a plain RCX list of node_t, so inserts and removes
+ * commit there with the RCX protocol.  The index levels only speed up the
+ * search for the bottom level predecessor.  Each index level is linked and
+ * unlinked under the RCX locks of the predecessor and the node, the same as
+ * the bottom level, so updaters of different parts of a list never share a
+ * lock.
+ */
+typedef struct sl_node {
+	node_t node;
+	int height;				/* number of index levels */
+	int nr_linked;				/* index levels linked so far */
+	struct sl_node *p_index[SL_MAX_LEVEL];	/* successor in each level */
+} sl_node_t;
+
+typedef struct skip_list {
+	sl_node_t *p_head;
+} skip_list_t;
+
+typedef struct skip_hash {
+	int n_buckets;
+	skip_list_t *buckets[MAX_BUCKETS];
+} skip_hash_t;
+
+__cacheline_aligned static skip_hash_t *g_skip_hash;
+
+#define sl_of(p_node)	container_of(p_node, sl_node_t, node)
+
+/*
+ * Allocate a skip list node of given height
+ */
+static sl_node_t *sl_new_node(val_t val, int height)
+{
+	int level;
+	sl_node_t *p_new_node = kmalloc(sizeof(sl_node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	rcx_init_node(&p_new_node->node);
+	p_new_node->node.val = val;
+	p_new_node->height = height;
+	p_new_node->nr_linked = 0;
+	for (level = 0; level < SL_MAX_LEVEL; level++)
+		p_new_node->p_index[level] = NULL;
+
+	return p_new_node;
+}
+
+/*
+ * Pick the number of index levels for a new node
+ */
+static int sl_random_height(void)
+{
+	u32 rnd = prandom_u32();
+	int height = 0;
+
+	while (height < SL_MAX_LEVEL &&
+			(rnd & ((1 << SL_LEVEL_SHIFT) - 1)) == 0) {
+		height++;
+		rnd >>= SL_LEVEL_SHIFT;
+	}
+
+	return height;
+}
+
+/*
+ * Allocate and initialize a skip list
+ */
+static skip_list_t *sl_new_list(void)
+{
+	skip_list_t *p_list;
+	sl_node_t *p_min_node, *p_max_node;
+	int level;
+
+	p_list = kmalloc(sizeof(skip_list_t), GFP_KERNEL);
+	if (p_list == NULL)
+		return NULL;
+
+	p_max_node = sl_new_node(LIST_VAL_MAX, SL_MAX_LEVEL);
+	p_max_node->node.p_next = NULL;
+
+	p_min_node = sl_new_node(LIST_VAL_MIN, SL_MAX_LEVEL);
+	p_min_node->node.p_next = &p_max_node->node;
+	for (level = 0; level < SL_MAX_LEVEL; level++)
+		p_min_node->p_index[level] = p_max_node;
+
+	p_list->p_head = p_min_node;
+
+	return p_list;
+}
+
+/*
+ * Find the bottom level node to start a search for a value from
+ *
+ * Descends the index levels down to the last indexed node smaller than the
+ * value.  Falls back to the head if the node is already removed, as the
+ * index levels are updated lazily.  Caller should be in RCU read-side
+ * critical section.
+ */
+static node_t *sl_find_start(skip_list_t *p_list, val_t val)
+{
+	sl_node_t *p_pred, *p_succ;
+	int level;
+
+	p_pred = p_list->p_head;
+	for (level = SL_MAX_LEVEL - 1; level >= 0; level--) {
+		while (1) {
+			p_succ = (sl_node_t *)RCU_DEREF(p_pred->p_index[level]);
+			if (p_succ->node.val >= val)
+				break;
+			p_pred = p_succ;
+		}
+	}
+
+	if (p_pred->node.removed)
+		return &p_list->p_head->node;
+	return &p_pred->node;
+}
+
+/*
+ * Find the predecessor of a value in an index level
+ *
+ * Caller should be in RCU read-side critical section.  The predecessor could
+ * be removed already, which the caller validates under its lock.
+ */
+static sl_node_t *sl_find_pred(skip_list_t *p_list, val_t val, int level)
+{
+	sl_node_t *p_pred, *p_succ;
+	int l;
+
+	p_pred = p_list->p_head;
+	for (l = SL_MAX_LEVEL - 1; l >= level; l--) {
+		while (1) {
+			p_succ = (sl_node_t *)RCU_DEREF(p_pred->p_index[l]);
+			if (p_succ->node.val >= val)
+				break;
+			p_pred = p_succ;
+		}
+	}
+
+	return p_pred;
+}
+
+/*
+ * Link a node, which is already in the bottom level, into its index levels
+ *
+ * Each level is linked under the locks of the predecessor and the node, after
+ * validating that the predecessor is still in the list and still points to
+ * the successor.  Linking stops once the node is removed, which is checked
+ * under its lock, so the remover sees the final nr_linked.  Caller should be
+ * in RCU read-side critical section.
+ */
+static void sl_index_link(skip_list_t *p_list, sl_node_t *p_new_node)
+{
+	node_t *nodes[2];
+	sl_node_t *p_pred, *p_succ;
+	int level;
+
+	for (level = 0; level < p_new_node->height; level++) {
+		while (1) {
+			p_pred = sl_find_pred(p_list, p_new_node->node.val,
+					level);
+			p_succ = (sl_node_t *)RCU_DEREF(p_pred->p_index[level]);
+			p_new_node->p_index[level] = p_succ;
+
+			nodes[0] = &p_pred->node;
+			nodes[1] = &p_new_node->node;
+			if (rcx_numa_lock(nodes, 2))
+				continue;
+
+			if (p_new_node->node.removed) {
+				rcx_numa_unlock(nodes, 2);
+				return;
+			}
+			if (!p_pred->node.removed &&
+					p_pred->p_index[level] == p_succ) {
+				RCU_ASSIGN_PTR((p_pred->p_index[level]),
+						p_new_node);
+				p_new_node->nr_linked = level + 1;
+				rcx_numa_unlock(nodes, 2);
+				break;
+			}
+			rcx_numa_unlock(nodes, 2);
+		}
+	}
+}
+
+/*
+ * Unlink a node, which is already removed from the bottom level, from its
+ * index levels
+ *
+ * Only the levels linked before the removal are unlinked, top down, each
+ * under the locks of the predecessor and the node.  A newer node of the same
+ * value could be indexed in front of it.  Caller should be in RCU read-side
+ * critical section.
+ */
+static void sl_index_unlink(skip_list_t *p_list, sl_node_t *p_node)
+{
+	node_t *nodes[2];
+	sl_node_t *p_pred, *p_succ;
+	int level;
+
+	for (level = p_node->nr_linked - 1; level >= 0; level--) {
+		while (1) {
+			p_pred = sl_find_pred(p_list, p_node->node.val, level);
+			p_succ = (sl_node_t *)RCU_DEREF(p_pred->p_index[level]);
+			while (p_succ != p_node &&
+					p_succ->node.val == p_node->node.val) {
+				p_pred = p_succ;
+				p_succ = (sl_node_t *)RCU_DEREF(
+						p_pred->p_index[level]);
+			}
+			/* Missed through a removed predecessor, so retry */
+			if (p_succ != p_node)
+				continue;
+
+			nodes[0] = &p_pred->node;
+			nodes[1] = &p_node->node;
+			if (rcx_numa_lock(nodes, 2))
+				continue;
+
+			if (!p_pred->node.removed &&
+					p_pred->p_index[level] == p_node) {
+				RCU_ASSIGN_PTR((p_pred->p_index[level]),
+						p_node->p_index[level]);
+				rcx_numa_unlock(nodes, 2);
+				break;
+			}
+			rcx_numa_unlock(nodes, 2);
+		}
+	}
+}
+
+/*
+ * Check whether a value is in the given skip list
+ *
+ * Returns one if exists, zero else
+ */
+static int sl_list_contains(skip_list_t *p_list, val_t val)
+{
+	int result;
+	val_t v;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+
+	RCU_READER_LOCK();
+
+	p_prev = sl_find_start(p_list, val);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+		v = p_node->val;
+
+		if (v >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (v == val);
+
+	RCU_READER_UNLOCK();
+
+	return result;
+}
+
+/*
+ * Insert a value into a skip list
+ *
+ * The bottom level is committed in the same way with rcx_list_numa_add(), and
+ * then the index levels are linked.
+ *
+ * Returns one if the value is in the list already, or zero if insert done and
+ * success.
+ */
+static int sl_list_add(skip_list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	val_t v;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = sl_find_start(p_list, val);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+		v = p_node->val;
+
+		if (v >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (v != val);
+
+	if (result) {
+		sl_node_t *p_new_node = sl_new_node(val, sl_random_height());
+
+		p_new_node->node.p_next = p_next;
+
+		if (rcx_numa_link(p_prev, p_next, &p_new_node->node)) {
+			RCU_READER_UNLOCK();
+			kfree(p_new_node);
+			goto retry;
+		}
+
+		if (p_new_node->height)
+			sl_index_link(p_list, p_new_node);
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Deletes a value from a skip list
+ *
+ * The bottom level is committed in the same way with rcx_list_numa_remove(),
+ * and then the node is unlinked from the index levels.  It is freed after a
+ * grace period, when no reader can reach it from any level.
+ *
+ * Returns 1 if success, 0 if the list doesn't contain the value.
+ */
+static int sl_list_remove(skip_list_t *p_list, val_t val)
+{
+	int result;
+	node_t *p_prev, *p_next;
+	node_t *p_node;
+	node_t *n;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = sl_find_start(p_list, val);
+	p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (1) {
+		p_node = (node_t *)RCU_DEREF(p_next);
+
+		if (p_node->val >= val)
+			break;
+
+		p_prev = p_next;
+		p_next = (node_t *)RCU_DEREF(p_prev->p_next);
+	}
+
+	result = (p_node->val == val);
+
+	if (result) {
+		n = (node_t *)RCU_DEREF(p_next->p_next);
+		/* p_prev -> p_next -> n */
+
+		if (rcx_numa_unlink(p_prev, p_next, n)) {
+			RCU_READER_UNLOCK();
+			goto retry;
+		}
+
+		if (sl_of(p_next)->nr_linked)
+			sl_index_unlink(p_list, sl_of(p_next));
+		kfree_rcu(sl_of(p_next), node.rcu);
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+static void sl_list_destroy(skip_list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = &p_list->p_head->node; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(sl_of(iter));
+	}
+}
+
+
+/**************************
+ * Hash of Skip Lists
+ **************************/
+
+/*
+ * Setup the global hash of skip lists
+ */
+int rcx_skip_list_init(int nr_buckets, void *dat)
+{
+	int i;
+
+	g_skip_hash = kmalloc(sizeof(skip_hash_t), GFP_KERNEL);
+	if (g_skip_hash == NULL)
+		return -ENOMEM;
+
+	g_skip_hash->n_buckets = nr_buckets;
+	for (i = 0; i < g_skip_hash->n_buckets; i++)
+		g_skip_hash->buckets[i] = sl_new_list();
+
+	return 0;
+}
+
+/*
+ * Destroy the global hash of skip lists
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_skip_list_destroy(void)
+{
+	int hash;
+
+	for (hash = 0; hash < g_skip_hash->n_buckets; hash++) {
+		sl_list_destroy(g_skip_hash->buckets[hash]);
+		kfree(g_skip_hash->buckets[hash]);
+	}
+	kfree(g_skip_hash);
+}
+
+/*
+ * Check whether a value is in the global hash of skip lists
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_skip_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_skip_hash, val);
+
+	return sl_list_contains(g_skip_hash->buckets[hash], val) ?
+		0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global hash of skip lists
+ *
+ * Returns zero only
+ */
+int rcx_skip_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_skip_hash, val);
+
+	sl_list_add(g_skip_hash->buckets[hash], val);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global hash of skip lists
+ *
+ * Returns zero only
+ */
+int rcx_skip_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_skip_hash, val);
+
+	sl_list_remove(g_skip_hash->buckets[hash], val);
+	return 0;
+}
@@ -0,0 +1,453 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/hash.h>
+
+
+#include "hash-list.h"
+#include "rtm.h"
+#include "rtm_debug.h"
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+#define RCU_WRITER_LOCK(lock)           spin_lock(&lock)
+#define RCU_WRITER_UNLOCK(lock)         spin_unlock(&lock)
+#define RCU_FREE(ptr)                   kfree_rcu(ptr, rcu)
+
+/* Hash bits consumed per level, so the slots of a node fill a cache line */
+#define TRIE_BITS		(4)
+#define TRIE_FANOUT		(1 << TRIE_BITS)
+#define TRIE_MAX_LEVEL		(32 / TRIE_BITS)
+
+/* Number of transactions tried before taking the node locks */
+#define TRIE_HTM_RETRY_LIMIT	(10)
+
+/*
+ * A slot is empty, a child node, or a value stored inline with the low bit
+ * set.  hash_32() over all 32 bits is a bijection, so two values always part
+ * at some level and no collision list is needed.
+ */
+#define TRIE_EMPTY		(0UL)
+#define is_leaf(slot)		((slot) & 1)
+#define leaf_of(val)		(((unsigned long)(u32)(val) << 1) | 1)
+#define val_of(slot)		((val_t)(u32)((slot) >> 1))
+
+/*
+ * Node of the hash trie
+ *
+ * A node that lost all but one value is contracted into its parent slot and
+ * marked dead.  Updates commit on a node with a transaction that checks its
+ * lock and the dead flag, or with the lock held on the fallback.
+ */
+typedef struct trie_node {
+	unsigned long __attribute__((aligned(CACHELINE_SIZE)))
+		slots[TRIE_FANOUT];
+	spinlock_t __attribute__((aligned(CACHELINE_SIZE))) lock;
+	int dead;
+	struct rcu_head rcu;
+} trie_node_t;
+
+__cacheline_aligned static trie_node_t *g_trie_root;
+
+static inline int trie_index(u32 hash, int level)
+{
+	return (hash >> (level * TRIE_BITS)) & (TRIE_FANOUT - 1);
+}
+
+static trie_node_t *trie_new_node(void)
+{
+	trie_node_t *p_new_node = kzalloc(sizeof(trie_node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	spin_lock_init(&p_new_node->lock);
+
+	return p_new_node;
+}
+
+/*
+ * Build the subtree holding two values from the given level down
+ *
+ * Returns the subtree or NULL if out of memory.
+ */
+static trie_node_t *trie_make_pair(val_t v1, val_t v2, int level)
+{
+	u32 h1 = hash_32(v1, 32);
+	u32 h2 = hash_32(v2, 32);
+	trie_node_t *p_node = trie_new_node();
+	trie_node_t *p_child;
+
+	if (p_node == NULL)
+		return NULL;
+
+	if (trie_index(h1, level) != trie_index(h2, level)) {
+		p_node->slots[trie_index(h1, level)] = leaf_of(v1);
+		p_node->slots[trie_index(h2, level)] = leaf_of(v2);
+		return p_node;
+	}
+
+	p_child = trie_make_pair(v1, v2, level + 1);
+	if (p_child == NULL) {
+		kfree(p_node);
+		return NULL;
+	}
+	p_node->slots[trie_index(h1, level)] = (unsigned long)p_child;
+
+	return p_node;
+}
+
+/*
+ * Replace a slot of a live node
+ *
+ * Returns zero if replaced, -EAGAIN if the slot changed or the node is dead.
+ */
+static int trie_commit_slot(trie_node_t *p_node, int index,
+		unsigned long old, unsigned long new)
+{
+	int tx_stat;
+	int retry;
+	int ret = -EAGAIN;
+
+	for (retry = 0; retry < TRIE_HTM_RETRY_LIMIT; retry++) {
+		while (spin_is_locked(&p_node->lock))
+			;
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(&p_node->lock))
+				_xabort(ABORT_LF_CONFLICT);
+			if (p_node->dead)
+				_xabort(ABORT_DOUBLE_FREE);
+			if (p_node->slots[index] != old)
+				_xabort(ABORT_CONFLICT);
+
+			p_node->slots[index] = new;
+			_xend();
+			return 0;
+		}
+		record_abort(tx_stat);
+		/* Validation failed, so the caller should retraverse */
+		if ((tx_stat & _XABORT_EXPLICIT) &&
+				_XABORT_CODE(tx_stat) != ABORT_LF_CONFLICT)
+			return -EAGAIN;
+	}
+
+	RCU_WRITER_LOCK(p_node->lock);
+	if (!p_node->dead && p_node->slots[index] == old) {
+		/* Publishes a subtree built aside */
+		smp_store_release(&p_node->slots[index], new);
+		ret = 0;
+	}
+	RCU_WRITER_UNLOCK(p_node->lock);
+
+	return ret;
+}
+
+/*
+ * Remove a value from a node and contract the node into its parent
+ *
+ * If the node keeps at most one value and no child, the parent slot takes
+ * that value, or becomes empty, and the node dies.  Both nodes change in one
+ * transaction, or under both locks taken parent first on the fallback.
+ *
+ * Returns zero if removed, -EAGAIN if either node changed.
+ */
+static int trie_commit_remove(trie_node_t *p_parent, int pindex,
+		trie_node_t *p_node, int index, unsigned long leaf)
+{
+	unsigned long rest = TRIE_EMPTY;
+	int nr_rest = 0;
+	int contracted = 0;
+	int tx_stat;
+	int retry;
+	int ret = -EAGAIN;
+	int i;
+
+	for (retry = 0; retry < TRIE_HTM_RETRY_LIMIT; retry++) {
+		while (spin_is_locked(&p_node->lock) ||
+				(p_parent && spin_is_locked(&p_parent->lock)))
+			;
+		tx_stat = _xbegin();
+		if (tx_stat == _XBEGIN_STARTED) {
+			if (spin_is_locked(&p_node->lock) ||
+					(p_parent &&
+					 spin_is_locked(&p_parent->lock)))
+				_xabort(ABORT_LF_CONFLICT);
+			if (p_node->dead || (p_parent && p_parent->dead))
+				_xabort(ABORT_DOUBLE_FREE);
+			if (p_node->slots[index] != leaf ||
+					(p_parent && p_parent->slots[pindex] !=
+					 (unsigned long)p_node))
+				_xabort(ABORT_CONFLICT);
+
+			rest = TRIE_EMPTY;
+			nr_rest = 0;
+			contracted = 0;
+			p_node->slots[index] = TRIE_EMPTY;
+			if (p_parent) {
+				for (i = 0; i < TRIE_FANOUT; i++) {
+					if (p_node->slots[i] != TRIE_EMPTY) {
+						rest = p_node->slots[i];
+						nr_rest++;
+					}
+				}
+				if (nr_rest == 0 || (nr_rest == 1 &&
+						is_leaf(rest))) {
+					p_parent->slots[pindex] = rest;
+					p_node->dead = 1;
+					contracted = 1;
+				}
+			}
+			_xend();
+			goto out;
+		}
+		record_abort(tx_stat);
+		/* Validation failed, so the caller should retraverse */
+		if ((tx_stat & _XABORT_EXPLICIT) &&
+				_XABORT_CODE(tx_stat) != ABORT_LF_CONFLICT)
+			return -EAGAIN;
+	}
+
+	if (p_parent)
+		RCU_WRITER_LOCK(p_parent->lock);
+	RCU_WRITER_LOCK(p_node->lock);
+
+	if (p_node->dead || p_node->slots[index] != leaf)
+		goto unlock;
+	if (p_parent && (p_parent->dead ||
+			p_parent->slots[pindex] != (unsigned long)p_node))
+		goto unlock;
+
+	WRITE_ONCE(p_node->slots[index], TRIE_EMPTY);
+	if (p_parent) {
+		for (i = 0; i < TRIE_FANOUT; i++) {
+			if (p_node->slots[i] != TRIE_EMPTY) {
+				rest = p_node->slots[i];
+				nr_rest++;
+			}
+		}
+		if (nr_rest == 0 || (nr_rest == 1 && is_leaf(rest))) {
+			WRITE_ONCE(p_parent->slots[pindex], rest);
+			p_node->dead = 1;
+			contracted = 1;
+		}
+	}
+	ret = 0;
+
+unlock:
+	RCU_WRITER_UNLOCK(p_node->lock);
+	if (p_parent)
+		RCU_WRITER_UNLOCK(p_parent->lock);
+	if (ret)
+		return ret;
+
+out:
+	/* Only the remover that contracted the node frees it */
+	if (contracted)
+		RCU_FREE(p_node);
+	return 0;
+}
+
+/*
+ * Check whether a value is in the trie
+ *
+ * Returns one if exists, zero else
+ */
+static int trie_contains(trie_node_t *p_root, val_t val)
+{
+	u32 hash = hash_32(val, 32);
+	trie_node_t *p_node = p_root;
+	unsigned long slot;
+	int level;
+	int result = 0;
+
+	RCU_READER_LOCK();
+
+	for (level = 0; level < TRIE_MAX_LEVEL; level++) {
+		slot = READ_ONCE(p_node->slots[trie_index(hash, level)]);
+		if (slot == TRIE_EMPTY)
+			break;
+		if (is_leaf(slot)) {
+			result = (val_of(slot) == val);
+			break;
+		}
+		p_node = (trie_node_t *)slot;
+	}
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Insert a value into the trie
+ *
+ * A value meeting another one in its slot splits the slot into a subtree,
+ * built aside and then committed in place of the other value.
+ *
+ * Returns one if inserted, zero if the value is in the trie already.
+ */
+static int trie_add(trie_node_t *p_root, val_t val)
+{
+	u32 hash = hash_32(val, 32);
+	trie_node_t *p_node, *p_sub;
+	unsigned long slot = TRIE_EMPTY;
+	unsigned long new;
+	int level, index = 0;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_node = p_root;
+	for (level = 0; level < TRIE_MAX_LEVEL; level++) {
+		index = trie_index(hash, level);
+		slot = READ_ONCE(p_node->slots[index]);
+		if (slot == TRIE_EMPTY || is_leaf(slot))
+			break;
+		p_node = (trie_node_t *)RCU_DEREF(slot);
+	}
+
+	if (slot == leaf_of(val)) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	p_sub = NULL;
+	new = leaf_of(val);
+	if (slot != TRIE_EMPTY) {
+		p_sub = trie_make_pair(val_of(slot), val, level + 1);
+		if (p_sub == NULL) {
+			RCU_READER_UNLOCK();
+			return 0;
+		}
+		new = (unsigned long)p_sub;
+	}
+
+	if (trie_commit_slot(p_node, index, slot, new)) {
+		RCU_READER_UNLOCK();
+		kfree(p_sub);
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+/*
+ * Delete a value from the trie
+ *
+ * Returns one if deleted, zero if the trie doesn't contain the value.
+ */
+static int trie_remove(trie_node_t *p_root, val_t val)
+{
+	u32 hash = hash_32(val, 32);
+	trie_node_t *p_parent, *p_node;
+	unsigned long slot = TRIE_EMPTY;
+	int level, index = 0, pindex;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_parent = NULL;
+	pindex = 0;
+	p_node = p_root;
+	for (level = 0; level < TRIE_MAX_LEVEL; level++) {
+		index = trie_index(hash, level);
+		slot = READ_ONCE(p_node->slots[index]);
+		if (slot == TRIE_EMPTY || is_leaf(slot))
+			break;
+		p_parent = p_node;
+		pindex = index;
+		p_node = (trie_node_t *)RCU_DEREF(slot);
+	}
+
+	if (slot != leaf_of(val)) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	if (trie_commit_remove(p_parent, pindex, p_node, index, slot)) {
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+static void trie_destroy(trie_node_t *p_node)
+{
+	unsigned long slot;
+	int i;
+
+	for (i = 0; i < TRIE_FANOUT; i++) {
+		slot = p_node->slots[i];
+		if (slot != TRIE_EMPTY && !is_leaf(slot))
+			trie_destroy((trie_node_t *)slot);
+	}
+	kfree(p_node);
+}
+
+
+/**************************
+ * Hash Trie
+ **************************/
+
+/*
+ * Setup the global hash trie
+ *
+ * The trie grows and shrinks with its population, so nr_buckets is not used.
+ */
+int rcx_trie_init(int nr_buckets, void *dat)
+{
+	g_trie_root = trie_new_node();
+	if (g_trie_root == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Destroy the global hash trie
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_trie_destroy(void)
+{
+	trie_destroy(g_trie_root);
+}
+
+/*
+ * Check whether a value is in the global hash trie
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_trie_contains(void *tl, val_t val)
+{
+	return trie_contains(g_trie_root, val) ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global hash trie
+ *
+ * Returns zero only
+ */
+int rcx_trie_add(void *tl, val_t val)
+{
+	trie_add(g_trie_root, val);
+	return 0;
+}
+
+/*
+ * Deletes a value from the global hash trie
+ *
+ * Returns zero only
+ */
+int rcx_trie_remove(void *tl, val_t val)
+{
+	trie_remove(g_trie_root, val);
+	return 0;
+}
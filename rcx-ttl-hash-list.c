@@ -0,0 +1,400 @@
+#include <linux/slab.h>  // kmalloc
+#include <linux/rcupdate.h>
+#include <linux/types.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+
+
+#include "hash-list.h"
+
+#define HASH_VALUE(p_hash_list, val)    (val % p_hash_list->n_buckets)
+
+#define RCU_READER_LOCK()               rcu_read_lock()
+#define RCU_READER_UNLOCK()             rcu_read_unlock()
+
+#define RCU_DEREF(p_obj)                (p_obj)
+
+/* Lifetime of an entry if the bench_conf_t doesn't give one */
+#define TTL_DEFAULT_MS		(100)
+/* Buckets the reaper walks per round, before it sleeps for a jiffy */
+#define TTL_REAP_BUCKETS	(16)
+/* Nodes the reaper unlinks before it waits for a grace period */
+#define TTL_REAP_BATCH		(256)
+/* Longest expired run unlinked by one commit */
+#define TTL_REAP_RUN		(RCX_RUN_MAX)
+
+/*
+ * Expiring node
+ *
+ * The list of nodes is a plain RCX list of node_t.  The expiry time is set
+ * before the node is linked and never changes, so an expired node stays
+ * expired, and unlinking it is always right.  An insert of an expired value
+ * unlinks the old node and links a new one.
+ */
+typedef struct ttl_node {
+	node_t node;
+	unsigned long expires;	/* in jiffies */
+} ttl_node_t;
+
+__cacheline_aligned static hash_list_t *g_hash_list;
+static unsigned long g_ttl;
+static struct task_struct *g_reaper;
+/* Nodes unlinked by the reaper, freed after one grace period */
+static ttl_node_t *g_reaped[TTL_REAP_BATCH];
+
+#define ttl_of(p_node)	container_of(p_node, ttl_node_t, node)
+
+static inline int ttl_expired(node_t *p_node, unsigned long now)
+{
+	return time_after_eq(now, ttl_of(p_node)->expires);
+}
+
+/*
+ * Allocate an expiring node
+ */
+static ttl_node_t *ttl_new_node(val_t val, unsigned long expires)
+{
+	ttl_node_t *p_new_node = kmalloc(sizeof(ttl_node_t), GFP_KERNEL);
+
+	if (p_new_node == NULL)
+		return NULL;
+
+	rcx_init_node(&p_new_node->node);
+	p_new_node->node.val = val;
+	p_new_node->expires = expires;
+
+	return p_new_node;
+}
+
+/*
+ * Allocate a sentinel of a list of expiring nodes, for rcx_new_list()
+ *
+ * The sentinels never expire in practice, and are never unlinked anyway.
+ */
+static node_t *ttl_alloc_node(val_t val)
+{
+	ttl_node_t *p_new_node = ttl_new_node(val, 0);
+
+	return p_new_node ? &p_new_node->node : NULL;
+}
+
+static void ttl_list_destroy(list_t *p_list)
+{
+	node_t *iter, *next;
+
+	for (iter = p_list->p_head; iter != NULL; iter = next) {
+		next = iter->p_next;
+		kfree(ttl_of(iter));
+	}
+}
+
+/*
+ * Insert a value into a list, replacing its expired node if any
+ *
+ * Returns one if inserted, zero if the value is in the list already, or
+ * -ENOMEM.
+ */
+static int ttl_list_add(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_next;
+	ttl_node_t *p_new_node;
+	unsigned long now;
+
+retry:
+	RCU_READER_LOCK();
+
+	now = jiffies;
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val == val) {
+		if (!ttl_expired(p_next, now)) {
+			RCU_READER_UNLOCK();
+			return 0;
+		}
+		if (rcx_numa_unlink(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next)) == 0)
+			kfree_rcu(ttl_of(p_next), node.rcu);
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+
+	p_new_node = ttl_new_node(val, now + g_ttl);
+	if (p_new_node == NULL) {
+		RCU_READER_UNLOCK();
+		return -ENOMEM;
+	}
+	p_new_node->node.p_next = p_next;
+
+	if (rcx_numa_link(p_prev, p_next, &p_new_node->node)) {
+		RCU_READER_UNLOCK();
+		kfree(p_new_node);
+		goto retry;
+	}
+
+	RCU_READER_UNLOCK();
+	return 1;
+}
+
+/*
+ * Delete a value from a list
+ *
+ * An expired node is unlinked as well, but not counted.
+ *
+ * Returns one if success, zero if the list doesn't contain the value.
+ */
+static int ttl_list_remove(list_t *p_list, val_t val)
+{
+	node_t *p_prev, *p_next;
+	int result;
+
+retry:
+	RCU_READER_LOCK();
+
+	p_prev = rcx_list_find(p_list, val, &p_next);
+	if (p_next->val != val) {
+		RCU_READER_UNLOCK();
+		return 0;
+	}
+
+	result = !ttl_expired(p_next, jiffies);
+	if (rcx_numa_unlink(p_prev, p_next,
+				(node_t *)RCU_DEREF(p_next->p_next))) {
+		RCU_READER_UNLOCK();
+		goto retry;
+	}
+	kfree_rcu(ttl_of(p_next), node.rcu);
+
+	RCU_READER_UNLOCK();
+	return result;
+}
+
+/*
+ * Unlink the expired nodes of a list, up to a free slot of g_reaped
+ *
+ * Each run of adjacent expired nodes, up to TTL_REAP_RUN long, is unlinked by
+ * one rcx_numa_unlink_run() commit.  A run that loses its commit to a
+ * concurrent update is skipped, and is left to the next round.
+ *
+ * The number of nodes in g_reaped is updated in *p_nr_reaped, also when it
+ * fills up.
+ *
+ * Returns zero if the whole list was walked, -EAGAIN if g_reaped filled up
+ * before the end of the list.
+ */
+static int ttl_reap_list(list_t *p_list, int *p_nr_reaped)
+{
+	node_t *run[TTL_REAP_RUN];
+	node_t *p_prev, *p_node;
+	unsigned long now = jiffies;
+	int nr_reaped = *p_nr_reaped;
+	int nr, i, ret = 0;
+
+	RCU_READER_LOCK();
+
+	p_prev = (node_t *)RCU_DEREF(p_list->p_head);
+	p_node = (node_t *)RCU_DEREF(p_prev->p_next);
+	while (p_node->p_next) {
+		if (!ttl_expired(p_node, now)) {
+			p_prev = p_node;
+			p_node = (node_t *)RCU_DEREF(p_node->p_next);
+			continue;
+		}
+		if (nr_reaped == TTL_REAP_BATCH) {
+			ret = -EAGAIN;
+			break;
+		}
+
+		/* Collect the run, p_node ends up after it */
+		nr = 0;
+		while (p_node->p_next && ttl_expired(p_node, now) &&
+				nr < TTL_REAP_RUN &&
+				nr_reaped + nr < TTL_REAP_BATCH) {
+			run[nr++] = p_node;
+			p_node = (node_t *)RCU_DEREF(p_node->p_next);
+		}
+
+		if (rcx_numa_unlink_run(p_prev, run, nr, p_node) == 0) {
+			/* p_prev stays, and the next run goes on from it */
+			for (i = 0; i < nr; i++)
+				g_reaped[nr_reaped++] = ttl_of(run[i]);
+		} else {
+			p_prev = run[nr - 1];
+		}
+	}
+
+	RCU_READER_UNLOCK();
+
+	*p_nr_reaped = nr_reaped;
+	return ret;
+}
+
+/*
+ * Free the nodes unlinked so far after one grace period for all of them
+ */
+static void ttl_reap_free(int nr_reaped)
+{
+	int i;
+
+	if (nr_reaped == 0)
+		return;
+
+	synchronize_rcu();
+	for (i = 0; i < nr_reaped; i++)
+		kfree(g_reaped[i]);
+}
+
+/*
+ * Reaper thread
+ *
+ * Walks TTL_REAP_BUCKETS buckets per round, round-robin over the table, so
+ * the work is spread over time instead of coming as one full scan.  Unlinked
+ * nodes are collected into batches of TTL_REAP_BATCH, and each batch costs
+ * one grace period.
+ */
+static int ttl_reaper(void *arg)
+{
+	int hash = 0, nr_reaped = 0;
+	int i, ret;
+
+	while (!kthread_should_stop()) {
+		for (i = 0; i < TTL_REAP_BUCKETS; i++) {
+			ret = ttl_reap_list(g_hash_list->buckets[hash],
+					&nr_reaped);
+			if (ret == -EAGAIN) {
+				/* Free the batch, and walk the bucket again */
+				ttl_reap_free(nr_reaped);
+				nr_reaped = 0;
+				continue;
+			}
+			hash = (hash + 1) % g_hash_list->n_buckets;
+		}
+
+		ttl_reap_free(nr_reaped);
+		nr_reaped = 0;
+		schedule_timeout_interruptible(1);
+	}
+
+	return 0;
+}
+
+
+/**************************
+ * Hash List
+ **************************/
+
+/*
+ * Setup the global expiring hash list
+ *
+ * The lifetime of entries comes from the bench_conf_t given as dat, and the
+ * reaper starts right away.
+ */
+int rcx_ttl_hash_list_init(int nr_buckets, void *dat)
+{
+	bench_conf_t *p_conf = dat;
+	struct task_struct *t;
+	int i;
+
+	g_ttl = msecs_to_jiffies(p_conf->ttl ? p_conf->ttl : TTL_DEFAULT_MS);
+
+	g_hash_list = kmalloc(sizeof(hash_list_t), GFP_KERNEL);
+	if (g_hash_list == NULL)
+		return -ENOMEM;
+
+	g_hash_list->n_buckets = nr_buckets;
+	for (i = 0; i < g_hash_list->n_buckets; i++) {
+		g_hash_list->buckets[i] = rcx_new_list(ttl_alloc_node);
+		if (g_hash_list->buckets[i] == NULL) {
+			g_hash_list->n_buckets = i;
+			g_reaper = NULL;
+			rcx_ttl_hash_list_destroy();
+			return -ENOMEM;
+		}
+	}
+
+	t = kthread_run(ttl_reaper, NULL, "rcx_ttl_reaper");
+	if (IS_ERR(t)) {
+		g_reaper = NULL;
+		rcx_ttl_hash_list_destroy();
+		return PTR_ERR(t);
+	}
+	g_reaper = t;
+
+	return 0;
+}
+
+/*
+ * Destroy the global expiring hash list
+ *
+ * Caller of this function should guarantee that there is no other concurrent
+ * threads accessing it.
+ */
+void rcx_ttl_hash_list_destroy(void)
+{
+	int hash;
+
+	if (g_reaper)
+		kthread_stop(g_reaper);
+	g_reaper = NULL;
+
+	/* Removed nodes may be freed with kfree_rcu() still */
+	rcu_barrier();
+
+	for (hash = 0; hash < g_hash_list->n_buckets; hash++) {
+		ttl_list_destroy(g_hash_list->buckets[hash]);
+		kfree(g_hash_list->buckets[hash]);
+	}
+	kfree(g_hash_list);
+}
+
+/*
+ * Check whether a value is in the global expiring hash list
+ *
+ * An expired value is absent, though the reaper has not unlinked it yet.
+ * Nothing is written.
+ *
+ * Returns zero if exists, -ENOENT else
+ */
+int rcx_ttl_hash_list_contains(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+	node_t *p_next;
+	int result;
+
+	RCU_READER_LOCK();
+
+	rcx_list_find(g_hash_list->buckets[hash], val, &p_next);
+	result = (p_next->val == val && !ttl_expired(p_next, jiffies));
+
+	RCU_READER_UNLOCK();
+
+	return result ? 0 : -ENOENT;
+}
+
+/*
+ * Inserts a value into the global expiring hash list
+ *
+ * The value expires after the lifetime from the insert.
+ *
+ * Returns zero, or -ENOMEM
+ */
+int rcx_ttl_hash_list_add(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	if (ttl_list_add(g_hash_list->buckets[hash], val) < 0)
+		return -ENOMEM;
+	return 0;
+}
+
+/*
+ * Deletes a value from the global expiring hash list
+ *
+ * Returns zero only
+ */
+int rcx_ttl_hash_list_remove(void *tl, val_t val)
+{
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	ttl_list_remove(g_hash_list->buckets[hash], val);
+	return 0;
+}
@@ -127,13 +127,13 @@ static int hash_list_size(hash_list_t *p_hash_list)
 /////////////////////////////////////////////////////////
 // LIST CONTAINS
 /////////////////////////////////////////////////////////
-int rlu_list_contains(rlu_thread_data_t *self, list_t *p_list, val_t val) {
-	int result;
+/*
+ * Walks the list inside the reader section the caller already holds.
+ */
+static int rlu_list_lookup(rlu_thread_data_t *self, list_t *p_list, val_t val) {
 	val_t v;
 	node_t *p_prev, *p_next;
 
-	RLU_READER_LOCK(self);
-	
 	p_prev = (node_t *)RLU_DEREF(self, (p_list->p_head));
 	p_next = (node_t *)RLU_DEREF(self, (p_prev->p_next));
 	while (1) {
@@ -148,8 +148,14 @@ int rlu_list_contains(rlu_thread_data_t *self, list_t *p_list, val_t val) {
 		p_next = (node_t *)RLU_DEREF(self, (p_prev->p_next));
 	}
 	
-	result = (v == val);
+	return (v == val);
+}
 
+int rlu_list_contains(rlu_thread_data_t *self, list_t *p_list, val_t val) {
+	int result;
+
+	RLU_READER_LOCK(self);
+	result = rlu_list_lookup(self, p_list, val);
 	RLU_READER_UNLOCK(self);
 
 	return result;
@@ -169,6 +175,70 @@ int rlu_hash_list_contains(void *tl, val_t val)
     return -ENOENT;
 }
 
+/////////////////////////////////////////////////////////
+// HASH LIST READ SESSION
+/////////////////////////////////////////////////////////
+/*
+ * A session keeps one RLU reader section open across several lookups, so the
+ * sync checkpoint, write-set bookkeeping and counters of
+ * rlu_reader_lock()/rlu_reader_unlock() are paid once per session.  The
+ * thread must not update the list until it closes the session, and sessions
+ * should be short, as writers wait for them to quiesce.
+ */
+void rlu_hash_list_read_begin(void *tl)
+{
+	rlu_thread_data_t *self = (rlu_thread_data_t *)tl;
+
+	RLU_READER_LOCK(self);
+}
+
+void rlu_hash_list_read_end(void *tl)
+{
+	rlu_thread_data_t *self = (rlu_thread_data_t *)tl;
+
+	RLU_READER_UNLOCK(self);
+}
+
+int rlu_hash_list_session_contains(void *tl, val_t val)
+{
+	rlu_thread_data_t *self = (rlu_thread_data_t *)tl;
+	int hash = HASH_VALUE(g_hash_list, val);
+
+	if (rlu_list_lookup(self, g_hash_list->buckets[hash], val))
+		return 0;
+	return -ENOENT;
+}
+
+/////////////////////////////////////////////////////////
+// HASH LIST CONTAINS BATCH
+/////////////////////////////////////////////////////////
+static node_t *rlu_batch_deref(void *tl, node_t *p_node)
+{
+	rlu_thread_data_t *self = (rlu_thread_data_t *)tl;
+
+	return (node_t *)RLU_DEREF(self, p_node);
+}
+
+/*
+ * Pipelines the traversals with hash_list_amac_contains(), inside a single RLU
+ * reader section.
+ *
+ * Stores zero to results[i] if keys[i] exists, -ENOENT else.  Returns the
+ * number of existing keys.
+ */
+int rlu_hash_list_contains_batch(void *tl, val_t *keys, int n, int *results)
+{
+	rlu_thread_data_t *self = (rlu_thread_data_t *)tl;
+	int nr_found;
+
+	RLU_READER_LOCK(self);
+	nr_found = hash_list_amac_contains(g_hash_list, keys, n, results,
+			rlu_batch_deref, self);
+	RLU_READER_UNLOCK(self);
+
+	return nr_found;
+}
+
 /////////////////////////////////////////////////////////
 // LIST ADD
 /////////////////////////////////////////////////////////
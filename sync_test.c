@@ -20,7 +20,7 @@
 #include "rtm_debug.h"
 
 #define MODULE_NAME    "sync_test"
-#define MAX_BENCHMARKS (16)
+#define MAX_BENCHMARKS (32)
 #ifndef RLU_DEFER_WS
 # define RLU_DEFER_WS  (10)
 #endif
@@ -39,25 +39,74 @@ MODULE_PARM_DESC(duration, "Duration of the benchmark in ms");
 static int update;
 module_param(update, int, 0000);
 MODULE_PARM_DESC(update, "Probability for update operations. No floating-point in kernel so 10000 = 100%, 1 = 0.01%");
+static int moves;
+module_param(moves, int, 0000);
+MODULE_PARM_DESC(moves, "Probability for an update to be an atomic move of a key to another, for benchmarks with moves.  10000 = 100%");
+static int cond_ops;
+module_param(cond_ops, int, 0000);
+MODULE_PARM_DESC(cond_ops, "Do updates by get-or-insert, compare-and-replace and delete-if of the data of a key, for benchmarks with conditional ops.");
 static int range = 1024;
 module_param(range, int, 0000);
 MODULE_PARM_DESC(range, "Key range. Initial set size is half the key range.");
 static int nr_buckets = 1;
 module_param(nr_buckets, int, 0000);
 MODULE_PARM_DESC(nr_buckets, "Number of buckets to utilize.  Defaults to 1.");
+static int batch_size = 1;
+module_param(batch_size, int, 0000);
+MODULE_PARM_DESC(batch_size, "Number of keys per batched lookup or update.  Defaults to 1 (no batching).");
+static int batch_merge;
+module_param(batch_merge, int, 0000);
+MODULE_PARM_DESC(batch_merge, "Answer batched lookups by one merge walk per bucket instead of interleaved traversals.");
+static int batch_snapshot;
+module_param(batch_snapshot, int, 0000);
+MODULE_PARM_DESC(batch_snapshot, "Answer batched lookups by an atomic snapshot of all keys.  Takes precedence over batch_merge.");
+static int session_ops = 1;
+module_param(session_ops, int, 0000);
+MODULE_PARM_DESC(session_ops, "Number of lookups per read-side session, or of ops for finger benchmarks.  Defaults to 1 (no session).");
+static int ttl;
+module_param(ttl, int, 0000);
+MODULE_PARM_DESC(ttl, "Lifetime of an entry in ms, for expiring benchmarks.  Defaults to 0 (their own default).");
+static int capacity;
+module_param(capacity, int, 0000);
+MODULE_PARM_DESC(capacity, "Most entries of a bounded cache, for caching benchmarks.  Defaults to 0 (their own default).");
 
 typedef struct benchmark {
 	char name[32];
 	int (*init)(int nr_buckets, void *dat);
 	int (*lookup)(void *tl, int key);
+	int (*lookup_batch)(void *tl, int *keys, int n, int *results);
+	int (*lookup_merge)(void *tl, int *keys, int n, int *results);
+	int (*lookup_snapshot)(void *tl, int *keys, int n, int *results);
+	void (*read_begin)(void *tl);
+	int (*session_lookup)(void *tl, int key);
+	void (*read_end)(void *tl);
 	int (*insert)(void *tl, int key);
 	int (*delete)(void *tl, int key);
+	int (*insert_many)(void *tl, int *keys, int n);
+	int (*delete_many)(void *tl, int *keys, int n);
+	int (*move)(void *tl, int from, int to);
+	int (*get_or_insert)(void *tl, int key, int data, int *p_data);
+	int (*compare_replace)(void *tl, int key, int old_data, int new_data);
+	int (*delete_if)(void *tl, int key, int data);
+	finger_t *(*finger_new)(void);
+	void (*finger_free)(finger_t *finger);
+	void (*finger_reset)(finger_t *finger);
+	int (*finger_lookup)(void *tl, int key, finger_t *finger);
+	int (*finger_insert)(void *tl, int key, finger_t *finger);
+	int (*finger_delete)(void *tl, int key, finger_t *finger);
 	void (*destroy)(void);
+	void (*flush)(void);
+	unsigned long (*nr_eliminated)(void);
 	unsigned long nb_lookup;
 	unsigned long nb_insert;
 	unsigned long nb_delete;
 	unsigned long nb_ins_abort;
 	unsigned long nb_del_abort;
+	unsigned long nb_move;
+	unsigned long nb_move_abort;
+	unsigned long nb_replace;
+	unsigned long nb_replace_abort;
+	unsigned long nb_changed;
 } benchmark_t;
 
 static benchmark_t benchmarks[MAX_BENCHMARKS] = {
@@ -65,6 +114,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcu",
 		.init = &rcu_hash_list_init,
 		.lookup = &rcu_hash_list_contains,
+		.lookup_batch = &rcu_hash_list_contains_batch,
+		.lookup_merge = &rcu_hash_list_contains_merge,
+		.read_begin = &rcu_hash_list_read_begin,
+		.session_lookup = &rcu_hash_list_session_contains,
+		.read_end = &rcu_hash_list_read_end,
 		.insert = &rcu_hash_list_add,
 		.delete = &rcu_hash_list_remove,
 		.destroy = &rcu_hash_list_destroy,
@@ -73,6 +127,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcu-forgive",	/* try and forgive */
 		.init = &rcu_hash_list_init,
 		.lookup = &rcu_hash_list_contains,
+		.lookup_batch = &rcu_hash_list_contains_batch,
+		.lookup_merge = &rcu_hash_list_contains_merge,
+		.read_begin = &rcu_hash_list_read_begin,
+		.session_lookup = &rcu_hash_list_session_contains,
+		.read_end = &rcu_hash_list_read_end,
 		.insert = &rcu_hash_list_try_add,
 		.delete = &rcu_hash_list_try_remove,
 		.destroy = &rcu_hash_list_destroy,
@@ -81,6 +140,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcu-fglock",	/* finer-grained locking */
 		.init = &rcu_hash_list_init,
 		.lookup = &rcu_hash_list_contains,
+		.lookup_batch = &rcu_hash_list_contains_batch,
+		.lookup_merge = &rcu_hash_list_contains_merge,
+		.read_begin = &rcu_hash_list_read_begin,
+		.session_lookup = &rcu_hash_list_session_contains,
+		.read_end = &rcu_hash_list_read_end,
 		.insert = &rcu_hash_list_fg_add,
 		.delete = &rcu_hash_list_fg_remove,
 		.destroy = &rcu_hash_list_destroy,
@@ -89,14 +153,36 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcu-numa",	/* finer-grained locking */
 		.init = &rcu_hash_list_init,
 		.lookup = &rcu_hash_list_contains,
+		.lookup_batch = &rcu_hash_list_contains_batch,
+		.lookup_merge = &rcu_hash_list_contains_merge,
+		.read_begin = &rcu_hash_list_read_begin,
+		.session_lookup = &rcu_hash_list_session_contains,
+		.read_end = &rcu_hash_list_read_end,
 		.insert = &rcu_hash_list_numa_add,
 		.delete = &rcu_hash_list_numa_remove,
 		.destroy = &rcu_hash_list_destroy,
 	},
+	{
+		.name = "rcu-optlock",	/* optimistic versioned locking */
+		.init = &rcu_hash_list_init,
+		.lookup = &rcu_hash_list_contains,
+		.lookup_batch = &rcu_hash_list_contains_batch,
+		.lookup_merge = &rcu_hash_list_contains_merge,
+		.read_begin = &rcu_hash_list_read_begin,
+		.session_lookup = &rcu_hash_list_session_contains,
+		.read_end = &rcu_hash_list_read_end,
+		.insert = &rcu_hash_list_optlock_add,
+		.delete = &rcu_hash_list_optlock_remove,
+		.destroy = &rcu_hash_list_destroy,
+	},
 	{
 		.name = "rlu",
 		.init = &rlu_hash_list_init,
 		.lookup = &rlu_hash_list_contains,
+		.lookup_batch = &rlu_hash_list_contains_batch,
+		.read_begin = &rlu_hash_list_read_begin,
+		.session_lookup = &rlu_hash_list_session_contains,
+		.read_end = &rlu_hash_list_read_end,
 		.insert = &rlu_hash_list_add,
 		.delete = &rlu_hash_list_remove,
 		.destroy = NULL,
@@ -105,6 +191,10 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rlu-forgive",
 		.init = &rlu_hash_list_init,
 		.lookup = &rlu_hash_list_contains,
+		.lookup_batch = &rlu_hash_list_contains_batch,
+		.read_begin = &rlu_hash_list_read_begin,
+		.session_lookup = &rlu_hash_list_session_contains,
+		.read_end = &rlu_hash_list_read_end,
 		.insert = &rlu_hash_list_try_add,
 		.delete = &rlu_hash_list_try_remove,
 		.destroy = NULL,
@@ -113,6 +203,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcuhtm",
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_lf_add,
 		.delete = &rcx_hash_list_lf_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -121,6 +216,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "forgive", /* forgive if trx aborts */
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_try_add,
 		.delete = &rcx_hash_list_try_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -129,6 +229,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "retry",	/* retry the trx until success */
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_retry_add,
 		.delete = &rcx_hash_list_retry_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -137,6 +242,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "hwa",		/* retry or fallback as hw advised */
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_fb1_add,
 		.delete = &rcx_hash_list_fb1_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -145,6 +255,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcx-htmlock",	/* hierarchical htm global lock */
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_htmlock_add,
 		.delete = &rcx_hash_list_htmlock_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -153,6 +268,11 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcx-hhtmlock",	/* hierarchical htm global lock */
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_hhtmlock_add,
 		.delete = &rcx_hash_list_hhtmlock_remove,
 		.destroy = &rcx_hash_list_destroy,
@@ -161,23 +281,181 @@ static benchmark_t benchmarks[MAX_BENCHMARKS] = {
 		.name = "rcx",
 		.init = &rcx_hash_list_init,
 		.lookup = &rcx_hash_list_contains,
+		.lookup_batch = &rcx_hash_list_contains_batch,
+		.lookup_merge = &rcx_hash_list_contains_merge,
+		.lookup_snapshot = &rcx_hash_list_contains_snapshot,
+		.read_begin = &rcx_hash_list_read_begin,
+		.session_lookup = &rcx_hash_list_session_contains,
+		.read_end = &rcx_hash_list_read_end,
+		.insert = &rcx_hash_list_numa_add,
+		.delete = &rcx_hash_list_numa_remove,
+		.insert_many = &rcx_hash_list_add_many,
+		.delete_many = &rcx_hash_list_remove_many,
+		.move = &rcx_hash_list_move,
+		.get_or_insert = &rcx_hash_list_get_or_add,
+		.compare_replace = &rcx_hash_list_compare_replace,
+		.delete_if = &rcx_hash_list_remove_if,
+		.destroy = &rcx_hash_list_destroy,
+	},
+	{
+		.name = "rcx-finger",	/* ops start from per-thread fingers */
+		.init = &rcx_hash_list_init,
+		.lookup = &rcx_hash_list_contains,
+		.read_begin = &rcx_hash_list_read_begin,
+		.read_end = &rcx_hash_list_read_end,
 		.insert = &rcx_hash_list_numa_add,
 		.delete = &rcx_hash_list_numa_remove,
+		.finger_new = &rcx_hash_list_finger_new,
+		.finger_free = &rcx_hash_list_finger_free,
+		.finger_reset = &rcx_hash_list_finger_reset,
+		.finger_lookup = &rcx_hash_list_finger_contains,
+		.finger_insert = &rcx_hash_list_finger_add,
+		.finger_delete = &rcx_hash_list_finger_remove,
 		.destroy = &rcx_hash_list_destroy,
 	},
+	{
+		.name = "rcx-skiplist",
+		.init = &rcx_skip_list_init,
+		.lookup = &rcx_skip_list_contains,
+		.insert = &rcx_skip_list_add,
+		.delete = &rcx_skip_list_remove,
+		.destroy = &rcx_skip_list_destroy,
+	},
+	{
+		.name = "rcx-adaptive",	/* list or sorted array per bucket */
+		.init = &rcx_adaptive_hash_list_init,
+		.lookup = &rcx_adaptive_hash_list_contains,
+		.insert = &rcx_adaptive_hash_list_add,
+		.delete = &rcx_adaptive_hash_list_remove,
+		.destroy = &rcx_adaptive_hash_list_destroy,
+	},
+	{
+		.name = "rcx-oa",	/* open addressing, sized by range */
+		.init = &rcx_oa_hash_init,
+		.lookup = &rcx_oa_hash_contains,
+		.insert = &rcx_oa_hash_add,
+		.delete = &rcx_oa_hash_remove,
+		.destroy = &rcx_oa_hash_destroy,
+	},
+	{
+		.name = "rcx-cuckoo",	/* two-choice cuckoo, sized by range */
+		.init = &rcx_cuckoo_hash_init,
+		.lookup = &rcx_cuckoo_hash_contains,
+		.insert = &rcx_cuckoo_hash_add,
+		.delete = &rcx_cuckoo_hash_remove,
+		.destroy = &rcx_cuckoo_hash_destroy,
+	},
+	{
+		.name = "rcx-trie",	/* hash trie, no nr_buckets */
+		.init = &rcx_trie_init,
+		.lookup = &rcx_trie_contains,
+		.insert = &rcx_trie_add,
+		.delete = &rcx_trie_remove,
+		.destroy = &rcx_trie_destroy,
+	},
+	{
+		.name = "harris",	/* CAS-based lock-free baseline */
+		.init = &harris_hash_list_init,
+		.lookup = &harris_hash_list_contains,
+		.insert = &harris_hash_list_add,
+		.delete = &harris_hash_list_remove,
+		.destroy = &harris_hash_list_destroy,
+	},
+	{
+		.name = "rcx-fc",	/* flat combining on hot buckets */
+		.init = &rcx_fc_hash_list_init,
+		.lookup = &rcx_fc_hash_list_contains,
+		.insert = &rcx_fc_hash_list_add,
+		.delete = &rcx_fc_hash_list_remove,
+		.destroy = &rcx_fc_hash_list_destroy,
+	},
+	{
+		.name = "rcx-deleg",	/* updates sent to the home node */
+		.init = &rcx_deleg_hash_list_init,
+		.lookup = &rcx_deleg_hash_list_contains,
+		.insert = &rcx_deleg_hash_list_add,
+		.delete = &rcx_deleg_hash_list_remove,
+		.destroy = &rcx_deleg_hash_list_destroy,
+	},
+	{
+		.name = "rcx-nr",	/* replica per NUMA node, shared log */
+		.init = &rcx_nr_hash_list_init,
+		.lookup = &rcx_nr_hash_list_contains,
+		.insert = &rcx_nr_hash_list_add,
+		.delete = &rcx_nr_hash_list_remove,
+		.destroy = &rcx_nr_hash_list_destroy,
+	},
+	{
+		.name = "rcx-oplog",	/* per-cpu logs, merged on read */
+		.init = &rcx_oplog_hash_list_init,
+		.lookup = &rcx_oplog_hash_list_contains,
+		.insert = &rcx_oplog_hash_list_add,
+		.delete = &rcx_oplog_hash_list_remove,
+		.destroy = &rcx_oplog_hash_list_destroy,
+	},
+	{
+		.name = "rcx-elim",	/* insert/delete pairs eliminated */
+		.init = &rcx_elim_hash_list_init,
+		.lookup = &rcx_elim_hash_list_contains,
+		.insert = &rcx_elim_hash_list_add,
+		.delete = &rcx_elim_hash_list_remove,
+		.destroy = &rcx_elim_hash_list_destroy,
+		.nr_eliminated = &rcx_elim_hash_list_nr_eliminated,
+	},
+	{
+		.name = "rcx-async",	/* queued updates, applied in batches */
+		.init = &rcx_async_hash_list_init,
+		.lookup = &rcx_async_hash_list_contains,
+		.insert = &rcx_async_hash_list_add_async,
+		.delete = &rcx_async_hash_list_remove_async,
+		.destroy = &rcx_async_hash_list_destroy,
+		.flush = &rcx_async_hash_list_flush,
+	},
+	{
+		.name = "rcx-counter",	/* counter map, inserts increment */
+		.init = &rcx_counter_hash_list_init,
+		.lookup = &rcx_counter_hash_list_contains,
+		.insert = &rcx_counter_hash_list_inc,
+		.delete = &rcx_counter_hash_list_remove,
+		.destroy = &rcx_counter_hash_list_destroy,
+	},
+	{
+		.name = "rcx-ttl",	/* expiring entries, reaped */
+		.init = &rcx_ttl_hash_list_init,
+		.lookup = &rcx_ttl_hash_list_contains,
+		.insert = &rcx_ttl_hash_list_add,
+		.delete = &rcx_ttl_hash_list_remove,
+		.destroy = &rcx_ttl_hash_list_destroy,
+	},
+	{
+		.name = "rcx-cache",	/* bounded cache, CLOCK eviction */
+		.init = &rcx_cache_hash_list_init,
+		.lookup = &rcx_cache_hash_list_contains,
+		.insert = &rcx_cache_hash_list_add,
+		.delete = &rcx_cache_hash_list_remove,
+		.destroy = &rcx_cache_hash_list_destroy,
+	},
 };
 
 typedef struct benchmark_thread {
 	benchmark_t *benchmark;
 	unsigned int id;
 	rlu_thread_data_t *rlu;
+	finger_t *finger;
 	struct rnd_state rnd;
+	int batch_keys[MAX_BATCH];
+	int batch_results[MAX_BATCH];
 	struct {
 		unsigned long nb_lookup;
 		unsigned long nb_insert;
 		unsigned long nb_delete;
 		unsigned long nb_ins_abort;
 		unsigned long nb_del_abort;
+		unsigned long nb_move;
+		unsigned long nb_move_abort;
+		unsigned long nb_replace;
+		unsigned long nb_replace_abort;
+		unsigned long nb_changed;
 	} ops;
 } benchmark_thread_t;
 
@@ -212,6 +490,80 @@ int benchmark_endtime(void)
 	return 0;
 }
 
+/*
+ * Run session_ops ops in one read-side session, each starting from the finger
+ * of its bucket
+ *
+ * The keys follow each other from val, as in the scans fingers are for.
+ */
+static void sync_test_finger_session(benchmark_thread_t *bench, int op,
+		int val)
+{
+	benchmark_t *b = bench->benchmark;
+	rlu_thread_data_t *self = bench->rlu;
+	int i;
+
+	b->read_begin(self);
+	b->finger_reset(bench->finger);
+	for (i = 0; i < session_ops; i++) {
+		if (op >= update) {
+			b->finger_lookup(self, val, bench->finger);
+			bench->ops.nb_lookup++;
+		} else if (rand_range(2, &bench->rnd) == 0) {
+			if (b->finger_insert(self, val, bench->finger) == 0)
+				bench->ops.nb_insert++;
+			else
+				bench->ops.nb_ins_abort++;
+		} else {
+			if (b->finger_delete(self, val, bench->finger) == 0)
+				bench->ops.nb_delete++;
+			else
+				bench->ops.nb_del_abort++;
+		}
+		op = rand_range(10000, &bench->rnd);
+		val = (val + 1) % range;
+	}
+	b->read_end(self);
+}
+
+/* Data values of conditional ops, few so that comparisons hit often */
+#define COND_DATA_RANGE	(4)
+
+/*
+ * Run one conditional update of a key
+ *
+ * A get-or-insert counts as an insert, and a delete-if as a delete.
+ */
+static void sync_test_cond_op(benchmark_thread_t *bench, int val)
+{
+	benchmark_t *b = bench->benchmark;
+	rlu_thread_data_t *self = bench->rlu;
+	int data = rand_range(COND_DATA_RANGE, &bench->rnd);
+	int old_data;
+
+	switch (rand_range(3, &bench->rnd)) {
+	case 0:
+		if (b->get_or_insert(self, val, data, &old_data) == 0)
+			bench->ops.nb_insert++;
+		else
+			bench->ops.nb_ins_abort++;
+		break;
+	case 1:
+		if (b->delete_if(self, val, data) == 0)
+			bench->ops.nb_delete++;
+		else
+			bench->ops.nb_del_abort++;
+		break;
+	default:
+		old_data = rand_range(COND_DATA_RANGE, &bench->rnd);
+		if (b->compare_replace(self, val, old_data, data) == 0)
+			bench->ops.nb_replace++;
+		else
+			bench->ops.nb_replace_abort++;
+		break;
+	}
+}
+
 static int sync_test_thread(void *data)
 {
 	benchmark_thread_t *bench = (benchmark_thread_t *)data;
@@ -219,6 +571,12 @@ static int sync_test_thread(void *data)
 	struct timespec start, end;
 	unsigned long long tsc_start, tsc_end;
 	rlu_thread_data_t *self = bench->rlu;
+	int (*lookup_batch)(void *tl, int *keys, int n, int *results);
+	int i, ret;
+
+	lookup_batch = batch_snapshot ? bench->benchmark->lookup_snapshot :
+		batch_merge ? bench->benchmark->lookup_merge :
+		bench->benchmark->lookup_batch;
 
 	/* Wait on barrier */
 	barrier_cross(&sync_test_barrier);
@@ -231,7 +589,53 @@ static int sync_test_thread(void *data)
 		int op = rand_range(10000, &bench->rnd);
 		int val = rand_range(range, &bench->rnd);
 
-		if (op < update) {
+		if (bench->finger) {
+			/* Ops starting from the fingers of the thread */
+			sync_test_finger_session(bench, op, val);
+		} else if (op < update && batch_size > 1 &&
+				bench->benchmark->insert_many &&
+				bench->benchmark->delete_many) {
+			/*
+			 * Batched update, counting each key as an update like
+			 * the single path, and the keys that changed apart
+			 */
+			op = rand_range(2, &bench->rnd);
+			bench->batch_keys[0] = val;
+			for (i = 1; i < batch_size; i++)
+				bench->batch_keys[i] = rand_range(range,
+						&bench->rnd);
+			if ((op & 1) == 0) {
+				ret = bench->benchmark->insert_many(self,
+						bench->batch_keys, batch_size);
+				if (ret >= 0) {
+					bench->ops.nb_insert += batch_size;
+					bench->ops.nb_changed += ret;
+				} else {
+					bench->ops.nb_ins_abort += batch_size;
+				}
+			} else {
+				ret = bench->benchmark->delete_many(self,
+						bench->batch_keys, batch_size);
+				if (ret >= 0) {
+					bench->ops.nb_delete += batch_size;
+					bench->ops.nb_changed += ret;
+				} else {
+					bench->ops.nb_del_abort += batch_size;
+				}
+			}
+		} else if (op < update && bench->benchmark->move &&
+				rand_range(10000, &bench->rnd) < moves) {
+			/* Atomic move, which keeps the set size */
+			if (bench->benchmark->move(self, val,
+					rand_range(range, &bench->rnd)) == 0)
+				bench->ops.nb_move++;
+			else
+				bench->ops.nb_move_abort++;
+		} else if (op < update && cond_ops &&
+				bench->benchmark->get_or_insert) {
+			/* Conditional update on the data of the key */
+			sync_test_cond_op(bench, val);
+		} else if (op < update) {
 			op = rand_range(2, &bench->rnd);
 			if ((op & 1) == 0) {
 				/* Insert */
@@ -248,6 +652,25 @@ static int sync_test_thread(void *data)
 					bench->ops.nb_del_abort++;
 				}
 			}
+		} else if (batch_size > 1 && lookup_batch) {
+			/* Batched lookup */
+			bench->batch_keys[0] = val;
+			for (i = 1; i < batch_size; i++)
+				bench->batch_keys[i] = rand_range(range,
+						&bench->rnd);
+			lookup_batch(self, bench->batch_keys, batch_size,
+					bench->batch_results);
+			bench->ops.nb_lookup += batch_size;
+		} else if (session_ops > 1 &&
+				bench->benchmark->session_lookup) {
+			/* Several lookups in one read-side session */
+			bench->benchmark->read_begin(self);
+			bench->benchmark->session_lookup(self, val);
+			for (i = 1; i < session_ops; i++)
+				bench->benchmark->session_lookup(self,
+						rand_range(range, &bench->rnd));
+			bench->benchmark->read_end(self);
+			bench->ops.nb_lookup += session_ops;
 		} else {
 			/* Lookup */
 			bench->benchmark->lookup(self, val);
@@ -328,6 +751,8 @@ static int *cpubind_numa_arr(int nr_threads)
 }
 #endif
 
+static bench_conf_t bench_conf;
+
 static int __init sync_test_init(void)
 {
 	benchmark_t *bench = NULL;
@@ -376,6 +801,31 @@ static int __init sync_test_init(void)
 				nr_buckets, MAX_BUCKETS);
 		return -EPERM;
 	}
+	if (batch_size < 1 || batch_size > MAX_BATCH) {
+		pr_err(MODULE_NAME ": Invalid batch size %d (MAX %d)\n",
+				batch_size, MAX_BATCH);
+		return -EPERM;
+	}
+	if (batch_size > 1 && (batch_snapshot ? bench->lookup_snapshot :
+				batch_merge ? bench->lookup_merge :
+				bench->lookup_batch) == NULL)
+		pr_notice(MODULE_NAME ": Benchmark %s has no batched lookup, batch_size ignored\n",
+				benchmark);
+	if (session_ops < 1) {
+		pr_err(MODULE_NAME ": Invalid number of lookups per session %d\n",
+				session_ops);
+		return -EPERM;
+	}
+	if (session_ops > 1 && bench->session_lookup == NULL &&
+			bench->finger_lookup == NULL)
+		pr_notice(MODULE_NAME ": Benchmark %s has no read-side session, session_ops ignored\n",
+				benchmark);
+	if (moves && bench->move == NULL)
+		pr_notice(MODULE_NAME ": Benchmark %s has no atomic move, moves ignored\n",
+				benchmark);
+	if (cond_ops && bench->get_or_insert == NULL)
+		pr_notice(MODULE_NAME ": Benchmark %s has no conditional ops, cond_ops ignored\n",
+				benchmark);
 	/* RLU stalls when 144 threads used */
 	if (!strcmp(bench->name, "rlu") && threads_nb >= 144)
 		goto print_result;
@@ -384,7 +834,10 @@ static int __init sync_test_init(void)
 	init_completion(&sync_test_working);
 	barrier_init(&sync_test_barrier, threads_nb);
 	rlu_init(RLU_TYPE_FINE_GRAINED, RLU_DEFER_WS);
-	bench->init(nr_buckets, NULL);
+	bench_conf.range = range;
+	bench_conf.ttl = ttl;
+	bench_conf.capacity = capacity;
+	bench->init(nr_buckets, &bench_conf);
 	for (i = 0; i < threads_nb; i++) {
 		benchmark_threads[i] = kzalloc(sizeof(*benchmark_threads[i]),
 				GFP_KERNEL);
@@ -402,6 +855,12 @@ static int __init sync_test_init(void)
 			return -ENOMEM;
 
 		rlu_thread_init(benchmark_threads[i]->rlu);
+
+		if (bench->finger_new) {
+			benchmark_threads[i]->finger = bench->finger_new();
+			if (benchmark_threads[i]->finger == NULL)
+				return -ENOMEM;
+		}
 	}
 
 	/* Half fill the set */
@@ -418,6 +877,9 @@ static int __init sync_test_init(void)
 					get_random_int() % range))
 			;
 	}
+	/* Asynchronous inserts should be applied before starting */
+	if (bench->flush)
+		bench->flush();
 
 	/* Start N-1 threads */
 #if BIND_CPU == BIND_CPU_SEQ
@@ -466,6 +928,12 @@ static int __init sync_test_init(void)
 		bench->nb_delete += benchmark_threads[i]->ops.nb_delete;
 		bench->nb_ins_abort += benchmark_threads[i]->ops.nb_ins_abort;
 		bench->nb_del_abort += benchmark_threads[i]->ops.nb_del_abort;
+		bench->nb_move += benchmark_threads[i]->ops.nb_move;
+		bench->nb_move_abort += benchmark_threads[i]->ops.nb_move_abort;
+		bench->nb_replace += benchmark_threads[i]->ops.nb_replace;
+		bench->nb_replace_abort +=
+			benchmark_threads[i]->ops.nb_replace_abort;
+		bench->nb_changed += benchmark_threads[i]->ops.nb_changed;
 	}
 
 print_result:
@@ -477,9 +945,25 @@ print_result:
 				duration);
 	pr_info(MODULE_NAME ": #update: %lu / s\n", (bench->nb_delete +
 				bench->nb_insert) * 1000 / duration);
-	nr_aborts = bench->nb_ins_abort + bench->nb_del_abort;
+	if (bench->insert_many && batch_size > 1)
+		pr_info(MODULE_NAME ": #batch changed: %lu / s\n",
+				bench->nb_changed * 1000 / duration);
+	if (bench->move && moves) {
+		pr_info(MODULE_NAME ": #move: %lu / s\n", bench->nb_move *
+					1000 / duration);
+		pr_info(MODULE_NAME ": #move abort: %lu / s\n",
+					bench->nb_move_abort * 1000 / duration);
+	}
+	if (bench->get_or_insert && cond_ops) {
+		pr_info(MODULE_NAME ": #replace: %lu / s\n", bench->nb_replace *
+					1000 / duration);
+		pr_info(MODULE_NAME ": #replace abort: %lu / s\n",
+				bench->nb_replace_abort * 1000 / duration);
+	}
+	nr_aborts = bench->nb_ins_abort + bench->nb_del_abort +
+		bench->nb_move_abort + bench->nb_replace_abort;
 	nr_ops = bench->nb_lookup + bench->nb_insert + bench->nb_delete +
-		nr_aborts;
+		bench->nb_move + bench->nb_replace + nr_aborts;
 	if (nr_ops == 0)
 		nr_ops = 1;
 	pr_info(MODULE_NAME ": #ops: %lu / s\n", (nr_ops * 1000 / duration));
@@ -494,11 +978,15 @@ print_result:
 	pr_info(MODULE_NAME ": #abort / ops : %lu / 1000 ops\n",
 				nr_aborts * 1000 / nr_ops);
 
-	nr_updates = bench->nb_insert + bench->nb_delete + nr_aborts;
+	nr_updates = bench->nb_insert + bench->nb_delete + bench->nb_move +
+		bench->nb_replace + nr_aborts;
 	if (nr_updates == 0)
 		nr_updates = 1;
 	pr_info(MODULE_NAME ": #abort / updates : %lu / 1000 updates\n",
 				nr_aborts * 1000 / nr_updates);
+	if (bench->nr_eliminated)
+		pr_info(MODULE_NAME ": #eliminated / updates : %lu / 1000 updates\n",
+				bench->nr_eliminated() * 1000 / nr_updates);
 
 	restat.duration_ms = duration;
 	restat.nr_issued_ops = nr_ops;
@@ -528,8 +1016,11 @@ print_result:
 	rlu_hash_list_destroy();
 
 cleaning:
-	for (i = 0; i < threads_nb; i++)
+	for (i = 0; i < threads_nb; i++) {
 		kvfree(benchmark_threads[i]->rlu);
+		if (bench->finger_free)
+			bench->finger_free(benchmark_threads[i]->finger);
+	}
 
 	rlu_finish();
 